@@ -0,0 +1,124 @@
+// Single-key versus batched lookup throughput.
+//
+// Build from the repository root:
+//     g++ -O2 -std=c++17 -Isrc bench/batch_lookup.cpp $(ls src/*.cpp | grep -v main.cpp) -pthread -o batch_lookup
+// Run from src/ so the filter finds resources/block.txt:
+//     cd src && ../batch_lookup
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "FlatUnorderedMap.h"
+#include "UnorderedMap.h"
+#include "hash_functions.h"
+#include "ipv4_lpm.h"
+#include "malicious_url_filter.h"
+
+using bench_clock = std::chrono::steady_clock;
+
+static double seconds_since(bench_clock::time_point start) {
+    return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+static void report(const char * name, size_t lookups, double single, double batch, size_t hits) {
+    std::cout << name << ": single " << single * 1e9 / lookups << " ns/lookup, batch "
+              << batch * 1e9 / lookups << " ns/lookup (" << single / batch << "x), hits " << hits << "\n";
+}
+
+// random dotted-quad CIDR strings, mostly past the small string buffer like real entries
+static std::string random_key(std::mt19937 & rng) {
+    return std::to_string(rng() & 0xff) + "." + std::to_string(rng() & 0xff) + "." +
+           std::to_string(rng() & 0xff) + "." + std::to_string(rng() & 0xff) + "/" + std::to_string(8 + rng() % 25);
+}
+
+template <typename Map>
+static void bench_map(const char * name, const std::vector<std::string> & keys, const std::vector<std::string> & queries) {
+
+    Map map(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) map.insert(typename Map::value_type(keys[i], static_cast<int>(i)));
+
+    size_t single_hits = 0;
+    bench_clock::time_point start = bench_clock::now();
+    for (const std::string & q : queries) single_hits += map.find(q) != map.end();
+    double single = seconds_since(start);
+
+    size_t batch_hits = 0;
+    std::vector<typename Map::iterator> found(256);
+    start = bench_clock::now();
+    for (size_t base = 0; base < queries.size(); base += found.size()) {
+        size_t n = std::min(found.size(), queries.size() - base);
+        map.find_batch(queries.data() + base, n, found.data());
+        for (size_t i = 0; i < n; ++i) batch_hits += found[i] != map.end();
+    }
+    double batch = seconds_since(start);
+
+    if (single_hits != batch_hits) std::cout << name << ": MISMATCH " << single_hits << " vs " << batch_hits << "\n";
+    report(name, queries.size(), single, batch, batch_hits);
+
+}
+
+int main() {
+
+    std::mt19937 rng(42);
+
+    // a table far larger than the caches, queried half hits and half misses
+    const size_t entries = 1000000, lookups = 2000000;
+    std::vector<std::string> keys(entries), queries(lookups);
+    for (std::string & k : keys) k = random_key(rng);
+    for (size_t i = 0; i < lookups; ++i) queries[i] = (i & 1) ? keys[rng() % entries] : random_key(rng);
+
+    bench_map<UnorderedMap<std::string,int,fnv1a_hash>>("UnorderedMap 1M", keys, queries);
+    bench_map<FlatUnorderedMap<std::string,int,fnv1a_hash>>("FlatUnorderedMap 1M", keys, queries);
+
+    // the prefix table over a million random /24s
+    ipv4_lpm lpm;
+    for (size_t i = 0; i < entries; ++i) lpm.insert(static_cast<uint32_t>(rng()), 24);
+    std::vector<uint32_t> addresses(lookups * 4);
+    for (uint32_t & a : addresses) a = static_cast<uint32_t>(rng());
+
+    size_t single_hits = 0;
+    bench_clock::time_point start = bench_clock::now();
+    for (uint32_t a : addresses) single_hits += lpm.contains(a);
+    double single = seconds_since(start);
+
+    std::vector<char> out(addresses.size());
+    start = bench_clock::now();
+    lpm.contains_batch(addresses.data(), addresses.size(), reinterpret_cast<bool*>(out.data()));
+    double batch = seconds_since(start);
+    size_t batch_hits = 0;
+    for (char c : out) batch_hits += c != 0;
+
+    if (single_hits != batch_hits) std::cout << "ipv4_lpm: MISMATCH\n";
+    report("ipv4_lpm 1M /24", addresses.size(), single, batch, batch_hits);
+
+    // the filter itself on block.txt entries
+    malicious_url_filter filter;
+    std::vector<std::string> entries_text;
+    std::ifstream file("resources/block.txt");
+    for (std::string line; std::getline(file, line); ) entries_text.push_back(line);
+    if (entries_text.empty()) { std::cout << "resources/block.txt not found; run from src/\n"; return 0; }
+
+    std::vector<std::string> filter_queries(lookups);
+    for (size_t i = 0; i < lookups; ++i) filter_queries[i] = (i & 1) ? entries_text[rng() % entries_text.size()] : random_key(rng);
+
+    single_hits = 0;
+    start = bench_clock::now();
+    for (const std::string & q : filter_queries) single_hits += filter.is_Malicious_URL(q);
+    single = seconds_since(start);
+
+    std::vector<std::string_view> filter_views(filter_queries.begin(), filter_queries.end());
+    std::vector<char> filter_out(lookups);
+    start = bench_clock::now();
+    filter.is_Malicious_batch(filter_views.data(), lookups, reinterpret_cast<bool*>(filter_out.data()));
+    batch = seconds_since(start);
+    batch_hits = 0;
+    for (char c : filter_out) batch_hits += c != 0;
+
+    report("malicious_url_filter block.txt", lookups, single, batch, batch_hits);
+
+}
@@ -0,0 +1,269 @@
+// Load time, lookup latency percentiles, thread scaling and memory per entry for the
+// filter and the maps, against std::unordered_map, on a synthetic block list.
+//
+// Build from the repository root:
+//     g++ -O2 -std=c++17 -Isrc bench/filter_bench.cpp $(ls src/*.cpp | grep -v main.cpp) -pthread -o filter_bench
+// Run from src/ (it also times loading resources/block.txt):
+//     cd src && ../filter_bench              # 1M entries, up to one thread per core
+//     cd src && ../filter_bench 10000000 8   # 10M entries, up to 8 threads
+// The synthetic list is written to filter_bench_list.txt in the working directory and removed afterwards.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <unistd.h>
+
+#include "FlatUnorderedMap.h"
+#include "UnorderedMap.h"
+#include "hash_functions.h"
+#include "malicious_url_filter.h"
+#include "result_cache.h"
+
+using bench_clock = std::chrono::steady_clock;
+
+static double seconds_since(bench_clock::time_point start) {
+    return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+// bytes currently held through counting_allocator, by every container that uses one
+static size_t counted_bytes = 0;
+
+template <typename T>
+struct counting_allocator {
+    using value_type = T;
+
+    counting_allocator() noexcept {}
+    template <typename U> counting_allocator(const counting_allocator<U> &) noexcept {}
+
+    T * allocate(size_t n) {
+        counted_bytes += n * sizeof(T);
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T * p, size_t n) noexcept {
+        counted_bytes -= n * sizeof(T);
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    template <typename U> bool operator==(const counting_allocator<U> &) const noexcept { return true; }
+    template <typename U> bool operator!=(const counting_allocator<U> &) const noexcept { return false; }
+};
+
+using counted_pair = counting_allocator<std::pair<const std::string_view, int>>;
+
+// resident set size, for what the counting allocator cannot see
+static size_t resident_bytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t total = 0, resident = 0;
+    statm >> total >> resident;
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+// half CIDR entries, half domain names, like a mixed feed
+static std::string random_entry(std::mt19937 & rng) {
+    if (rng() & 1) {
+        return std::to_string(rng() & 0xff) + "." + std::to_string(rng() & 0xff) + "." +
+               std::to_string(rng() & 0xff) + "." + std::to_string(rng() & 0xff) + "/" + std::to_string(8 + rng() % 25);
+    }
+    static const char * const tlds[] = { "com", "net", "org", "io", "ru", "info" };
+    std::string name;
+    for (size_t n = 5 + rng() % 12; n > 0; --n) name += static_cast<char>('a' + rng() % 26);
+    return name + "." + tlds[rng() % 6];
+}
+
+/*
+    Times each lookup on its own and prints percentiles. The clock's own cost,
+    measured the same way, is subtracted, so short lookups read near zero
+    rather than near the clock overhead.
+*/
+static void print_latency(const char * name, const std::vector<std::string_view> & queries,
+                          const std::function<bool(std::string_view)> & lookup) {
+
+    std::vector<double> ns(queries.size());
+    std::vector<double> overhead(std::min<size_t>(queries.size(), 100000));
+    for (double & o : overhead) {
+        bench_clock::time_point a = bench_clock::now();
+        o = std::chrono::duration<double, std::nano>(bench_clock::now() - a).count();
+    }
+    std::nth_element(overhead.begin(), overhead.begin() + overhead.size() / 2, overhead.end());
+    double clock_cost = overhead[overhead.size() / 2];
+
+    size_t hits = 0;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        bench_clock::time_point a = bench_clock::now();
+        hits += lookup(queries[i]);
+        ns[i] = std::max(0.0, std::chrono::duration<double, std::nano>(bench_clock::now() - a).count() - clock_cost);
+    }
+    std::sort(ns.begin(), ns.end());
+
+    auto at = [&ns](double q) { return ns[std::min(ns.size() - 1, static_cast<size_t>(q * static_cast<double>(ns.size())))]; };
+    std::printf("  %-34s p50 %7.1f  p90 %7.1f  p99 %7.1f  p99.9 %8.1f ns  (%zu/%zu hits)\n",
+                name, at(0.50), at(0.90), at(0.99), at(0.999), hits, queries.size());
+
+}
+
+template <typename Map>
+static void bench_map(const char * name, Map map, const std::vector<std::string_view> & keys,
+                      const std::vector<std::string_view> & hits, const std::vector<std::string_view> & misses) {
+
+    size_t before = counted_bytes;
+    map.max_load_factor(0.75f);
+
+    // inserts from empty, so growth is part of the cost
+    bench_clock::time_point start = bench_clock::now();
+    for (size_t i = 0; i < keys.size(); ++i) map.insert(typename Map::value_type(keys[i], static_cast<int>(i)));
+    double insert = seconds_since(start);
+
+    size_t found = 0;
+    start = bench_clock::now();
+    for (std::string_view q : hits) found += map.find(q) != map.end();
+    for (std::string_view q : misses) found += map.find(q) != map.end();
+    double lookup = seconds_since(start);
+
+    std::printf("%s: insert %.1f ns/key, lookup %.1f ns/key, %.1f bytes/entry (keys not included)\n", name,
+                insert * 1e9 / static_cast<double>(keys.size()), lookup * 1e9 / static_cast<double>(hits.size() + misses.size()),
+                static_cast<double>(counted_bytes - before) / static_cast<double>(map.size()));
+    if (found != hits.size()) std::printf("  MISMATCH: %zu found, expected %zu\n", found, hits.size());
+
+    print_latency("positive", hits, [&map](std::string_view q) { return map.find(q) != map.end(); });
+    print_latency("negative", misses, [&map](std::string_view q) { return map.find(q) != map.end(); });
+
+}
+
+int main(int argc, char ** argv) {
+
+    size_t entries = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    size_t max_threads = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : std::max(1u, std::thread::hardware_concurrency());
+    size_t lookups = std::min<size_t>(entries, 1000000);
+    if (entries == 0 || max_threads == 0) {
+        std::cerr << "usage: " << argv[0] << " [entries] [max threads]\n";
+        return 2;
+    }
+
+    std::mt19937 rng(2024);
+    std::vector<std::string> dataset(entries);
+    for (std::string & entry : dataset) entry = random_entry(rng);
+
+    std::vector<std::string> absent(lookups);
+    for (std::string & entry : absent) entry = random_entry(rng) + "x";
+
+    std::vector<std::string_view> keys(dataset.begin(), dataset.end());
+    std::vector<std::string_view> hits(lookups), misses(absent.begin(), absent.end());
+    for (std::string_view & q : hits) q = keys[rng() % entries];
+
+    std::printf("%zu entries, %zu positive and %zu negative queries\n\n", entries, lookups, lookups);
+
+    // load time, from a file like any block list
+    const char * list_path = "filter_bench_list.txt";
+    {
+        std::ofstream list(list_path, std::ios::trunc);
+        for (const std::string & entry : dataset) list << entry << '\n';
+    }
+
+    {
+        std::ifstream sample("resources/block.txt");
+        if (sample) {
+            bench_clock::time_point start = bench_clock::now();
+            malicious_url_filter block;
+            std::printf("load resources/block.txt: %.2f ms\n", seconds_since(start) * 1e3);
+        }
+    }
+
+    size_t rss_before = resident_bytes();
+    bench_clock::time_point start = bench_clock::now();
+    malicious_url_filter filter(list_path, "");
+    double load = seconds_since(start);
+    size_t rss = resident_bytes() - rss_before;
+
+    std::printf("load %zu entries: %.2f s (%.2f M entries/s), %.1f MB resident, %.1f bytes/entry\n", entries, load,
+                static_cast<double>(entries) / load / 1e6, static_cast<double>(rss) / 1e6,
+                static_cast<double>(rss) / static_cast<double>(entries));
+
+    // load time as loader threads are added, after the resident size is taken
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        start = bench_clock::now();
+        malicious_url_filter reloaded(list_path, "", threads);
+        double seconds = seconds_since(start);
+        std::printf("  %2zu loader thread%s %6.2f s\n", threads, threads == 1 ? ": " : "s:", seconds);
+    }
+    std::remove(list_path);
+
+    std::printf("malicious_url_filter::is_Malicious_URL\n");
+    print_latency("positive", hits, [&filter](std::string_view q) { return filter.is_Malicious_URL(q); });
+    print_latency("negative", misses, [&filter](std::string_view q) { return filter.is_Malicious_URL(q); });
+
+    // skewed traffic: nine queries in ten go to 2000 hot keys, as a few clients dominate real logs
+    std::vector<std::string_view> skewed(2 * lookups);
+    for (size_t i = 0; i < skewed.size(); ++i) {
+        bool hot = rng() % 10 != 0;
+        size_t pick = hot ? rng() % 1000 : rng() % lookups;
+        skewed[i] = rng() % 2 ? hits[pick] : misses[pick];
+    }
+    cached_filter<malicious_url_filter> cache(filter);
+    std::printf("skewed queries (90%% on 2000 keys)\n");
+    print_latency("uncached", skewed, [&filter](std::string_view q) { return filter.is_Malicious_URL(q); });
+    print_latency("cached_filter", skewed, [&cache](std::string_view q) { return cache.is_Malicious_URL(q); });
+    filter_stats cached = cache.stats();
+    std::printf("  result cache hit rate %.1f%%\n",
+                100.0 * static_cast<double>(cached.cache_hits) / static_cast<double>(cached.cache_hits + cached.cache_misses));
+
+    // throughput over a read-only filter as threads are added, half hits and half misses
+    std::vector<std::string_view> mixed;
+    mixed.reserve(2 * lookups);
+    for (size_t i = 0; i < lookups; ++i) {
+        mixed.push_back(hits[i]);
+        mixed.push_back(misses[i]);
+    }
+
+    std::printf("\nthroughput (each thread runs the whole mixed query set)\n");
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        std::vector<size_t> found(threads, 0);
+        std::vector<std::thread> workers;
+        start = bench_clock::now();
+        for (size_t t = 0; t < threads; ++t) {
+            workers.emplace_back([&filter, &mixed, &found, t] {
+                size_t n = 0;
+                for (std::string_view q : mixed) n += filter.is_Malicious_URL(q);
+                found[t] = n;
+            });
+        }
+        for (std::thread & worker : workers) worker.join();
+        double seconds = seconds_since(start);
+
+        std::printf("  %2zu thread%s %8.2f M lookups/s\n", threads, threads == 1 ? ": " : "s:",
+                    static_cast<double>(threads * mixed.size()) / seconds / 1e6);
+        for (size_t n : found) if (n != found[0]) std::printf("  MISMATCH between threads\n");
+    }
+
+    // a feed-sized delta against the whole list: half new entries, half removals of listed ones
+    filter_delta delta;
+    delta.sequence = 1;
+    for (size_t i = 0; i < 25; ++i) {
+        delta.added.push_back(random_entry(rng));
+        delta.removed.push_back(dataset[rng() % entries]);
+    }
+    start = bench_clock::now();
+    bool applied = filter.apply_delta(delta);
+    std::printf("\napply a 50-line delta: %.3f ms%s\n", seconds_since(start) * 1e3, applied ? "" : " (REJECTED)");
+
+    // the maps on the same keys, after the filter so its resident size is measured on a fresh heap
+    std::printf("\n");
+    bench_map("UnorderedMap", UnorderedMap<std::string_view, int, fnv1a_hash, std::equal_to<>, prime_fastmod_range, counted_pair>(1), keys, hits, misses);
+    bench_map("FlatUnorderedMap", FlatUnorderedMap<std::string_view, int, fnv1a_hash, std::equal_to<>, counted_pair>(1), keys, hits, misses);
+    bench_map("std::unordered_map (fnv1a_hash)", std::unordered_map<std::string_view, int, fnv1a_hash, std::equal_to<>, counted_pair>(1), keys, hits, misses);
+    bench_map("std::unordered_map (std::hash)", std::unordered_map<std::string_view, int, std::hash<std::string_view>, std::equal_to<>, counted_pair>(1), keys, hits, misses);
+
+}
@@ -0,0 +1,118 @@
+// Hasher speed and bucket distribution on the block list keys.
+//
+// Build from the repository root:
+//     g++ -O2 -std=c++17 -Isrc bench/hash_bench.cpp $(ls src/*.cpp | grep -v main.cpp) -pthread -o hash_bench
+// Run from src/ so it finds resources/block.txt:
+//     cd src && ../hash_bench
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "hash_functions.h"
+#include "ipv4.h"
+#include "range_hash.h"
+
+using bench_clock = std::chrono::steady_clock;
+
+// spread of keys over buckets, compared against an ideal random hash
+struct distribution {
+    size_t max_chain;
+    double empty_fraction;
+    double chi_squared;  // per bucket; about 1 for a random hash, higher means clustering
+};
+
+template <typename Index>
+static distribution measure(const std::vector<uint64_t> & codes, size_t bucket_count, Index index) {
+
+    std::vector<uint32_t> counts(bucket_count);
+    for (uint64_t code : codes) ++counts[index(code)];
+
+    double expected = static_cast<double>(codes.size()) / bucket_count;
+    distribution d { 0, 0.0, 0.0 };
+    for (uint32_t c : counts) {
+        d.max_chain = std::max<size_t>(d.max_chain, c);
+        d.empty_fraction += c == 0;
+        d.chi_squared += (c - expected) * (c - expected) / expected;
+    }
+    d.empty_fraction /= bucket_count;
+    d.chi_squared /= bucket_count;
+    return d;
+
+}
+
+template <typename Key, typename Hasher>
+static void bench(const char * name, const std::vector<Key> & keys, size_t bytes, Hasher hash) {
+
+    // enough rounds to run for a measurable time
+    const size_t rounds = std::max<size_t>(1, 20000000 / keys.size());
+    uint64_t sink = 0;
+    bench_clock::time_point start = bench_clock::now();
+    for (size_t r = 0; r < rounds; ++r)
+        for (const Key & key : keys) sink += hash(key);
+    double seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+
+    std::vector<uint64_t> codes;
+    codes.reserve(keys.size());
+    for (const Key & key : keys) codes.push_back(hash(key));
+
+    // the filter's setup: prime buckets at load factor 0.75
+    size_t primes = prime_fastmod_range::size_for(keys.size() * 4 / 3);
+    distribution prime = measure(codes, primes, prime_fastmod_range(primes));
+
+    // a plain power-of-two mask sees only the low bits, like FlatUnorderedMap's fingerprints
+    size_t pow2 = pow2_range::size_for(keys.size() * 4 / 3);
+    distribution mask = measure(codes, pow2, [pow2](uint64_t code) { return code & (pow2 - 1); });
+
+    double ideal_empty = std::exp(-static_cast<double>(keys.size()) / primes);
+    std::cout << std::left << std::setw(24) << name << std::right << std::fixed
+              << std::setprecision(2) << std::setw(7) << seconds * 1e9 / (rounds * keys.size()) << " ns/key "
+              << std::setw(6) << bytes * rounds / seconds / 1e9 << " GB/s | prime: max "
+              << prime.max_chain << ", empty " << std::setprecision(3) << prime.empty_fraction
+              << " (ideal " << ideal_empty << "), chi2 " << prime.chi_squared << " | mask: max "
+              << mask.max_chain << ", chi2 " << mask.chi_squared << (sink == 1 ? " " : "") << "\n";
+
+}
+
+int main(int argc, char ** argv) {
+
+    std::ifstream file(argc > 1 ? argv[1] : "resources/block.txt");
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(file, line); ) if (!line.empty()) lines.push_back(line);
+    if (lines.empty()) {
+        std::cerr << "no keys loaded\n";
+        return 1;
+    }
+
+    std::vector<std::string_view> keys(lines.begin(), lines.end());
+    size_t bytes = 0;
+    for (std::string_view key : keys) bytes += key.size();
+    std::cout << keys.size() << " string keys, " << bytes / keys.size() << " bytes average\n";
+
+    bench("polynomial_rolling_hash", keys, bytes, polynomial_rolling_hash());
+    bench("fnv1a_hash", keys, bytes, fnv1a_hash());
+    bench("fnv1a_wide_hash", keys, bytes, fnv1a_wide_hash());
+    bench("wy_hash", keys, bytes, wy_hash());
+    bench("crc32c_hash", keys, bytes, crc32c_hash());
+
+    // the same entries as packed network addresses
+    std::vector<uint32_t> networks;
+    for (std::string_view key : keys) {
+        ipv4_prefix prefix;
+        if (parse_ipv4_cidr(key, prefix)) networks.push_back(prefix.network);
+    }
+    std::cout << "\n" << networks.size() << " IPv4 network keys\n";
+    bench("std::hash<uint32_t>", networks, networks.size() * 4, std::hash<uint32_t>());
+    bench("ipv4_hash", networks, networks.size() * 4, ipv4_hash());
+
+    return 0;
+
+}
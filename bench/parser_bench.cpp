@@ -0,0 +1,238 @@
+// IPv4 / IPv6 / CIDR parser throughput, plus a fuzz comparison against inet_pton.
+//
+// Build from the repository root:
+//     g++ -O2 -std=c++17 -Isrc bench/parser_bench.cpp $(ls src/*.cpp | grep -v main.cpp) -pthread -o parser_bench
+// Run from src/ so it finds resources/block.txt:
+//     cd src && ../parser_bench
+// Exits nonzero if the fuzz pass finds a disagreement.
+
+#include <arpa/inet.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ipv4.h"
+#include "ipv6.h"
+
+using bench_clock = std::chrono::steady_clock;
+
+static double seconds_since(bench_clock::time_point start) {
+    return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+static std::string random_address(std::mt19937 & rng) {
+    return std::to_string(rng() & 0xff) + "." + std::to_string(rng() & 0xff) + "." +
+           std::to_string(rng() & 0xff) + "." + std::to_string(rng() & 0xff);
+}
+
+// an IPv6 address in a random one of its text forms: case, leading zeros, "::", trailing dotted quad
+static std::string random_address6(std::mt19937 & rng) {
+
+    uint16_t groups[8];
+    for (uint16_t & group : groups) group = (rng() % 3 == 0) ? 0 : static_cast<uint16_t>(rng());
+
+    // compress a run of zero groups, if it is all zeros
+    int from = -1, to = -1;
+    if (rng() & 1) {
+        from = static_cast<int>(rng() % 8);
+        to = from + static_cast<int>(rng() % (8 - from));
+        for (int i = from; i <= to; ++i) if (groups[i] != 0) from = to = -1;
+    }
+    bool quad = rng() % 4 == 0 && to < 6;
+
+    std::string text;
+    char digits[8];
+    for (int i = 0; i < (quad ? 6 : 8); ++i) {
+        if (i == from) {
+            text += "::";
+            i = to;
+            continue;
+        }
+        if (!text.empty() && text.back() != ':') text += ':';
+        std::snprintf(digits, sizeof(digits), (rng() & 1) ? "%x" : "%04X", groups[i]);
+        text += digits;
+    }
+    if (quad) text += (text.empty() || text.back() == ':' ? "" : ":") + random_address(rng);
+    return text;
+
+}
+
+// what a strict CIDR parser should return, built on inet_pton for the address part
+static bool reference_cidr(const std::string & text, ipv4_prefix & out) {
+
+    size_t slash = text.find('/');
+    std::string address = text.substr(0, slash);
+    in_addr parsed;
+    if (address.find('\0') != std::string::npos || inet_pton(AF_INET, address.c_str(), &parsed) != 1) return false;
+
+    uint32_t length = 32;
+    if (slash != std::string::npos) {
+        std::string digits = text.substr(slash + 1);
+        if (digits.empty() || digits.size() > 2 || (digits.size() == 2 && digits[0] == '0')) return false;
+        for (char c : digits) if (c < '0' || c > '9') return false;
+        length = static_cast<uint32_t>(std::stoi(digits));
+        if (length > 32) return false;
+    }
+
+    out.length = static_cast<uint8_t>(length);
+    out.network = ntohl(parsed.s_addr) & ipv4_mask(out.length);
+    return true;
+
+}
+
+// random edits of valid entries: the inputs most likely to expose an off-by-one
+static std::string mutate(std::string text, std::mt19937 & rng, std::string_view alphabet = "0123456789./ x\n-+:") {
+    for (unsigned edits = rng() % 4; edits > 0; --edits) {
+        size_t at = text.empty() ? 0 : rng() % (text.size() + 1);
+        switch (rng() % 4) {
+            case 0: text.insert(at, 1, alphabet[rng() % alphabet.size()]); break;
+            case 1: if (at < text.size()) text.erase(at, 1); break;
+            case 2: if (at < text.size()) text[at] = alphabet[rng() % alphabet.size()]; break;
+            default: if (at < text.size()) text[at] = static_cast<char>(rng()); break;
+        }
+    }
+    return text;
+}
+
+static size_t fuzz(std::mt19937 & rng, size_t rounds) {
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < rounds; ++i) {
+
+        // valid addresses, near misses (leading zeros, 256+, short/long octets), and CIDR suffixes
+        std::string text = (rng() & 1) ? random_address(rng)
+                                       : std::to_string(rng() % 1000) + "." + std::to_string(rng() % 300) + "." +
+                                         std::to_string(rng() % 300) + "." + std::string(rng() % 2, '0') + std::to_string(rng() % 300);
+        if (rng() % 3 == 0) text += "/" + std::string(rng() % 3 == 0, '0') + std::to_string(rng() % 40);
+        text = mutate(text, rng);
+
+        uint32_t address = 0, expected_address = 0;
+        in_addr parsed;
+        bool expected = text.find('\0') == std::string::npos && inet_pton(AF_INET, text.c_str(), &parsed) == 1;
+        if (expected) expected_address = ntohl(parsed.s_addr);
+        bool got = parse_ipv4(text, address);
+
+        ipv4_prefix prefix { 0, 0 }, expected_prefix { 0, 0 };
+        bool expected_cidr = reference_cidr(text, expected_prefix);
+        bool got_cidr = parse_ipv4_cidr(text, prefix);
+
+        bool bad = got != expected || (got && address != expected_address) || got_cidr != expected_cidr ||
+                   (got_cidr && (prefix.network != expected_prefix.network || prefix.length != expected_prefix.length));
+        if (bad && ++mismatches <= 10) std::cout << "  mismatch on \"" << text << "\"\n";
+    }
+    return mismatches;
+
+}
+
+static size_t fuzz6(std::mt19937 & rng, size_t rounds) {
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < rounds; ++i) {
+        std::string text = mutate(random_address6(rng), rng, "0123456789abcdefABCDEFg.:/ %");
+
+        unsigned char parsed[16];
+        bool expected = text.find('\0') == std::string::npos && inet_pton(AF_INET6, text.c_str(), parsed) == 1;
+        ipv6_address expected_address { 0, 0 }, address { 0, 0 };
+        for (int b = 0; expected && b < 16; ++b) {
+            uint64_t & half = b < 8 ? expected_address.high : expected_address.low;
+            half = (half << 8) | parsed[b];
+        }
+        bool got = parse_ipv6(text, address);
+
+        if ((got != expected || (got && !(address == expected_address))) && ++mismatches <= 10)
+            std::cout << "  mismatch on \"" << text << "\"\n";
+    }
+    return mismatches;
+
+}
+
+int main() {
+
+    std::mt19937 rng(7);
+
+    // throughput on random addresses and random CIDR entries
+    const size_t count = 4000000;
+    std::vector<std::string> addresses(count), prefixes(count);
+    for (std::string & a : addresses) a = random_address(rng);
+    for (std::string & p : prefixes) p = random_address(rng) + "/" + std::to_string(rng() % 33);
+
+    uint64_t sink = 0;
+    bench_clock::time_point start = bench_clock::now();
+    for (const std::string & a : addresses) {
+        uint32_t address;
+        if (parse_ipv4(a, address)) sink += address;
+    }
+    double seconds = seconds_since(start);
+    std::cout << "parse_ipv4:      " << count / seconds / 1e6 << " M/s\n";
+
+    start = bench_clock::now();
+    for (const std::string & p : prefixes) {
+        ipv4_prefix prefix;
+        if (parse_ipv4_cidr(p, prefix)) sink += prefix.network + prefix.length;
+    }
+    seconds = seconds_since(start);
+    std::cout << "parse_ipv4_cidr: " << count / seconds / 1e6 << " M/s\n";
+
+    start = bench_clock::now();
+    for (const std::string & a : addresses) {
+        in_addr parsed;
+        if (inet_pton(AF_INET, a.c_str(), &parsed) == 1) sink += parsed.s_addr;
+    }
+    seconds = seconds_since(start);
+    std::cout << "inet_pton:       " << count / seconds / 1e6 << " M/s\n";
+
+    // the same for IPv6, on a quarter as many addresses
+    std::vector<std::string> addresses6(count / 4);
+    for (std::string & a : addresses6) a = random_address6(rng);
+
+    start = bench_clock::now();
+    for (const std::string & a : addresses6) {
+        ipv6_address address;
+        if (parse_ipv6(a, address)) sink += address.low;
+    }
+    seconds = seconds_since(start);
+    std::cout << "parse_ipv6:      " << addresses6.size() / seconds / 1e6 << " M/s\n";
+
+    start = bench_clock::now();
+    for (const std::string & a : addresses6) {
+        in6_addr parsed;
+        if (inet_pton(AF_INET6, a.c_str(), &parsed) == 1) sink += parsed.s6_addr[15];
+    }
+    seconds = seconds_since(start);
+    std::cout << "inet_pton (v6):  " << addresses6.size() / seconds / 1e6 << " M/s\n";
+
+    // bulk parsing of the block list, repeated to a measurable size
+    std::ifstream file("resources/block.txt");
+    std::stringstream contents;
+    contents << file.rdbuf();
+    std::string block = contents.str();
+    if (!block.empty()) {
+        std::string text;
+        while (text.size() < (64u << 20)) text += block + "\n";
+
+        std::vector<ipv4_prefix> parsed;
+        std::vector<std::string_view> others;
+        start = bench_clock::now();
+        size_t lines = parse_ipv4_cidr_lines(text, parsed, others);
+        seconds = seconds_since(start);
+        std::cout << "bulk lines:      " << lines / seconds / 1e6 << " M lines/s, "
+                  << text.size() / seconds / 1e9 << " GB/s (" << parsed.size() << " prefixes, "
+                  << others.size() << " other)\n";
+    }
+
+    size_t mismatches = fuzz(rng, 5000000);
+    std::cout << "fuzz vs inet_pton: " << mismatches << " mismatches" << (sink == 1 ? " " : "") << "\n";
+    size_t mismatches6 = fuzz6(rng, 2000000);
+    std::cout << "IPv6 fuzz vs inet_pton: " << mismatches6 << " mismatches\n";
+    mismatches += mismatches6;
+    return mismatches == 0 ? 0 : 1;
+
+}
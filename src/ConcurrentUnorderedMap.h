@@ -0,0 +1,175 @@
+#pragma once
+
+#include <cstddef>    // size_t
+#include <cstdint>    // uint64_t
+#include <functional> // std::hash
+#include <memory>     // std::unique_ptr
+#include <mutex>      // std::unique_lock
+#include <shared_mutex>
+#include <utility>    // std::pair
+#include <vector>
+
+#include "UnorderedMap.h"
+
+/**
+ * ## Concurrent Unordered Map
+ * @brief A thread-safe map made of independent UnorderedMap shards, each behind its own reader/writer lock.
+ *
+ * The top bits of a key's hash pick its shard, so threads touching different
+ * shards never contend, and a writer only excludes readers of the one shard it
+ * is changing. Lookups take the shard lock shared, so any number of readers
+ * proceed together. Each shard sits on its own cache lines to avoid false sharing.
+ *
+ * Values are returned by copy (or visited under the lock) since a reference
+ * into a shard would outlive the lock protecting it.
+ */
+template <typename Key, typename T, typename Hash = std::hash<Key>, typename Pred = std::equal_to<Key>,
+          typename RangeHash = prime_fastmod_range, typename Allocator = std::allocator<std::pair<const Key, T>>>
+class ConcurrentUnorderedMap {
+    public:
+
+    using shard_map = UnorderedMap<Key, T, Hash, Pred, RangeHash, Allocator>;
+    using key_type = Key;
+    using mapped_type = T;
+    using hasher = Hash;
+    using key_equal = Pred;
+    using value_type = typename shard_map::value_type;
+    using size_type = size_t;
+
+    static constexpr size_type DEFAULT_SHARDS = 64;
+
+    private:
+
+    struct alignas(64) shard {
+        mutable std::shared_mutex lock;
+        shard_map map;
+
+        shard(size_type bucket_count, const Hash & hash, const Pred & equal, const Allocator & alloc)
+            : lock(), map(bucket_count, hash, equal, alloc) {}
+    };
+
+    std::vector<std::unique_ptr<shard>> _shards;
+    unsigned _shard_bits;
+    Hash _hash;
+
+    template <typename K>
+    shard & _shard_for(const K & key) const {
+        if (this->_shard_bits == 0) return *this->_shards[0];
+        uint64_t code = static_cast<uint64_t>(this->_hash(key));
+        return *this->_shards[code >> (64 - this->_shard_bits)];
+    }
+
+    public:
+
+    /**
+        @brief Creates an empty map.
+
+        @param bucket_count the total initial bucket count, split across shards.
+        @param shard_count the number of shards, rounded up to a power of two.
+    **/
+    explicit ConcurrentUnorderedMap(size_type bucket_count = 0, size_type shard_count = DEFAULT_SHARDS,
+                const Hash & hash = Hash { }, const key_equal & equal = key_equal { },
+                const Allocator & alloc = Allocator { }) : _shards(), _shard_bits(0), _hash(hash) {
+
+                    while ((size_type(1) << this->_shard_bits) < shard_count) ++this->_shard_bits;
+                    size_type shards = size_type(1) << this->_shard_bits;
+
+                    this->_shards.reserve(shards);
+                    for (size_type i = 0; i < shards; ++i)
+                        this->_shards.push_back(std::make_unique<shard>(bucket_count / shards + 1, hash, equal, alloc));
+
+                }
+
+    ConcurrentUnorderedMap(const ConcurrentUnorderedMap &) = delete;
+    ConcurrentUnorderedMap & operator=(const ConcurrentUnorderedMap &) = delete;
+
+    /**
+        @brief Inserts value unless its key is present.
+
+        @return true if the value was inserted.
+    **/
+    bool insert(const value_type & value) {
+        shard & s = this->_shard_for(value.first);
+        std::unique_lock<std::shared_mutex> lock(s.lock);
+        return s.map.insert(value).second;
+    }
+
+    bool insert(value_type && value) {
+        shard & s = this->_shard_for(value.first);
+        std::unique_lock<std::shared_mutex> lock(s.lock);
+        return s.map.insert(std::move(value)).second;
+    }
+
+    /**
+        @brief Copies the value mapped to key into out.
+
+        @return true if key was found.
+    **/
+    template <typename K>
+    bool find(const K & key, T & out) const {
+        const shard & s = this->_shard_for(key);
+        std::shared_lock<std::shared_mutex> lock(s.lock);
+        auto it = s.map.find(key);
+        if (it == s.map.cend()) return false;
+        out = it->second;
+        return true;
+    }
+
+    template <typename K>
+    bool contains(const K & key) const {
+        const shard & s = this->_shard_for(key);
+        std::shared_lock<std::shared_mutex> lock(s.lock);
+        return s.map.contains(key);
+    }
+
+    /**
+        @brief Calls f(const value_type &) on key's entry while holding its shard's read lock.
+
+        @return true if key was found.
+    **/
+    template <typename K, typename F>
+    bool visit(const K & key, F && f) const {
+        const shard & s = this->_shard_for(key);
+        std::shared_lock<std::shared_mutex> lock(s.lock);
+        auto it = s.map.find(key);
+        if (it == s.map.cend()) return false;
+        f(*it);
+        return true;
+    }
+
+    size_type erase(const Key & key) {
+        shard & s = this->_shard_for(key);
+        std::unique_lock<std::shared_mutex> lock(s.lock);
+        return s.map.erase(key);
+    }
+
+    void clear() {
+        for (auto & s : this->_shards) {
+            std::unique_lock<std::shared_mutex> lock(s->lock);
+            s->map.clear();
+        }
+    }
+
+    // totals are summed shard by shard, so they are only a snapshot while writers are active
+    size_type size() const {
+        size_type total = 0;
+        for (auto & s : this->_shards) {
+            std::shared_lock<std::shared_mutex> lock(s->lock);
+            total += s->map.size();
+        }
+        return total;
+    }
+
+    size_type bucket_count() const {
+        size_type total = 0;
+        for (auto & s : this->_shards) {
+            std::shared_lock<std::shared_mutex> lock(s->lock);
+            total += s->map.bucket_count();
+        }
+        return total;
+    }
+
+    float load_factor() const { return static_cast<float>(this->size()) / static_cast<float>(this->bucket_count()); }
+
+    size_type shard_count() const noexcept { return this->_shards.size(); }
+};
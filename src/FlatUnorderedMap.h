@@ -0,0 +1,524 @@
+#pragma once
+
+#include <cstddef>    // size_t
+#include <cstdint>    // int8_t, uint64_t
+#include <cstring>    // std::memcpy, std::memset
+#include <functional> // std::hash
+#include <memory>     // std::allocator, std::allocator_traits
+#include <iterator>   // std::forward_iterator_tag
+#include <new>        // placement new
+#include <utility>    // std::pair
+
+#include "prefetch.h"
+
+/**
+ * ## Flat Unordered Map
+ * @brief An open-addressing sibling of UnorderedMap with the same insert/find/erase/load_factor API.
+ *
+ * Entries live inline in one slot array. A parallel array of one-byte control
+ * words holds either a 7-bit fingerprint of the entry's hash (full slot) or an
+ * empty/deleted marker, and probing scans 8 control bytes at a time with word
+ * arithmetic, so most lookups touch one control word and one slot. Capacity is
+ * a power of two and the table grows once it is 7/8 full.
+ */
+template <typename Key, typename T, typename Hash = std::hash<Key>, typename Pred = std::equal_to<Key>,
+          typename Allocator = std::allocator<std::pair<const Key, T>>>
+class FlatUnorderedMap {
+    public:
+
+    using key_type = Key;
+    using mapped_type = T;
+    using hasher = Hash;
+    using key_equal = Pred;
+    using allocator_type = Allocator;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using reference = value_type &;
+    using const_reference = const value_type &;
+    using pointer = value_type *;
+    using const_pointer = const value_type *;
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+
+    private:
+
+    // control byte states; full slots store the low 7 bits of the hash
+    static constexpr int8_t EMPTY = -128;
+    static constexpr int8_t DELETED = -2;
+
+    // number of control bytes scanned per probe step
+    static constexpr size_type GROUP_WIDTH = 8;
+
+    // number of keys find_batch keeps in flight between prefetch passes
+    static constexpr size_type BATCH_SIZE = 16;
+    static constexpr uint64_t LSBS = 0x0101010101010101ull;
+    static constexpr uint64_t MSBS = 0x8080808080808080ull;
+
+    // control bytes and slots both come from Allocator, rebound to their own types
+    using ctrl_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<int8_t>;
+    using ctrl_traits = std::allocator_traits<ctrl_allocator>;
+    using slot_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<value_type>;
+    using slot_traits = std::allocator_traits<slot_allocator>;
+
+    int8_t * _ctrl;
+    value_type * _slots;
+    size_type _capacity;
+    size_type _size;
+    size_type _growth_left;
+
+    Hash _hash;
+    key_equal _equal;
+    ctrl_allocator _ctrl_alloc;
+    slot_allocator _slot_alloc;
+
+    static size_type _h1(size_t hash_code) { return hash_code >> 7; }
+    static int8_t _h2(size_t hash_code) { return static_cast<int8_t>(hash_code & 0x7f); }
+
+    static size_type _max_size_for(size_type capacity) { return capacity - capacity / 8; }
+
+    static size_type _capacity_for(size_type count) {
+        size_type capacity = GROUP_WIDTH;
+        while (_max_size_for(capacity) < count) capacity *= 2;
+        return capacity;
+    }
+
+    // a group is the 8 control bytes starting at pos; the first GROUP_WIDTH bytes are mirrored past the end
+    uint64_t _group(size_type pos) const {
+        uint64_t group;
+        std::memcpy(&group, this->_ctrl + pos, sizeof(group));
+        return group;
+    }
+
+    // high bit set in every byte equal to h2 (may report false positives after a true match)
+    static uint64_t _match(uint64_t group, int8_t h2) {
+        uint64_t x = group ^ (LSBS * static_cast<uint8_t>(h2));
+        return (x - LSBS) & ~x & MSBS;
+    }
+
+    static uint64_t _match_empty(uint64_t group) { return group & (~group << 6) & MSBS; }
+    static uint64_t _match_empty_or_deleted(uint64_t group) { return group & (~group << 7) & MSBS; }
+
+    // byte offset of the lowest set match bit (little endian control words)
+    static size_type _lowest(uint64_t mask) { return static_cast<size_type>(__builtin_ctzll(mask)) / 8; }
+
+    void _set_ctrl(size_type i, int8_t h) {
+        this->_ctrl[i] = h;
+        if (i < GROUP_WIDTH) this->_ctrl[this->_capacity + i] = h;
+    }
+
+    void _allocate(size_type capacity) {
+        this->_capacity = capacity;
+        this->_ctrl = ctrl_traits::allocate(this->_ctrl_alloc, capacity + GROUP_WIDTH);
+        std::memset(this->_ctrl, EMPTY, capacity + GROUP_WIDTH);
+        this->_slots = slot_traits::allocate(this->_slot_alloc, capacity);
+        this->_size = 0;
+        this->_growth_left = _max_size_for(capacity);
+    }
+
+    void _destroy_slots() noexcept {
+        for (size_type i = 0; i < this->_capacity; ++i)
+            if (this->_ctrl[i] >= 0) this->_slots[i].~value_type();
+    }
+
+    void _free_arrays(int8_t * ctrl, value_type * slots, size_type capacity) noexcept {
+        if (ctrl != nullptr) ctrl_traits::deallocate(this->_ctrl_alloc, ctrl, capacity + GROUP_WIDTH);
+        if (slots != nullptr) slot_traits::deallocate(this->_slot_alloc, slots, capacity);
+    }
+
+    void _deallocate() noexcept {
+        this->_free_arrays(this->_ctrl, this->_slots, this->_capacity);
+        this->_ctrl = nullptr;
+        this->_slots = nullptr;
+    }
+
+    // find_batch for either iterator type
+    template <typename K, typename It>
+    void _find_batch(const K * keys, size_type count, It * out) const {
+
+        size_t codes[BATCH_SIZE];
+        size_type mask = this->_capacity - 1;
+
+        for (size_type base = 0; base < count; base += BATCH_SIZE) {
+            size_type n = count - base < BATCH_SIZE ? count - base : BATCH_SIZE;
+
+            for (size_type i = 0; i < n; ++i) {
+                codes[i] = this->_hash(keys[base + i]);
+                size_type pos = _h1(codes[i]) & mask;
+                MAP_PREFETCH(this->_ctrl + pos);
+                MAP_PREFETCH(this->_slots + pos);
+            }
+
+            for (size_type i = 0; i < n; ++i)
+                out[base + i] = It(this, this->_find(keys[base + i], codes[i]));
+        }
+
+    }
+
+    template <typename K>
+    size_type _find(const K & key, size_t hash_code) const {
+
+        size_type mask = this->_capacity - 1;
+        size_type pos = _h1(hash_code) & mask;
+        int8_t h2 = _h2(hash_code);
+
+        // probe group by group until the key or an empty slot is seen
+        for (size_type step = GROUP_WIDTH; ; step += GROUP_WIDTH) {
+            uint64_t group = this->_group(pos);
+            for (uint64_t m = _match(group, h2); m != 0; m &= m - 1) {
+                size_type i = (pos + _lowest(m)) & mask;
+                if (this->_ctrl[i] == h2 && this->_equal(this->_slots[i].first, key)) return i;
+            }
+            if (_match_empty(group) != 0) return this->_capacity;
+            pos = (pos + step) & mask;
+        }
+
+    }
+
+    size_type _find_free(size_t hash_code) const {
+
+        size_type mask = this->_capacity - 1;
+        size_type pos = _h1(hash_code) & mask;
+
+        // the table is never full, so this always terminates
+        for (size_type step = GROUP_WIDTH; ; step += GROUP_WIDTH) {
+            uint64_t m = _match_empty_or_deleted(this->_group(pos));
+            if (m != 0) return (pos + _lowest(m)) & mask;
+            pos = (pos + step) & mask;
+        }
+
+    }
+
+    void _resize(size_type capacity) {
+
+        int8_t * old_ctrl = this->_ctrl;
+        value_type * old_slots = this->_slots;
+        size_type old_capacity = this->_capacity;
+        size_type size = this->_size;
+
+        this->_allocate(capacity);
+
+        // move every full slot into the new table; keys are unique so no lookup is needed
+        for (size_type i = 0; i < old_capacity; ++i) {
+            if (old_ctrl[i] < 0) continue;
+            value_type & src = old_slots[i];
+            size_t hash_code = this->_hash(src.first);
+            size_type j = this->_find_free(hash_code);
+            this->_set_ctrl(j, _h2(hash_code));
+            // the source slot is destroyed right after, so its key may be moved from
+            new (this->_slots + j) value_type(std::move(const_cast<key_type&>(src.first)), std::move(src.second));
+            src.~value_type();
+        }
+
+        this->_size = size;
+        this->_growth_left -= size;
+
+        this->_free_arrays(old_ctrl, old_slots, old_capacity);
+
+    }
+
+    template <typename V>
+    std::pair<size_type, bool> _insert(V && value) {
+
+        size_t hash_code = this->_hash(value.first);
+        size_type i = this->_find(value.first, hash_code);
+        if (i != this->_capacity) return std::pair<size_type,bool>(i, false);
+
+        i = this->_find_free(hash_code);
+
+        // grow when taking an empty slot would pass the load limit (deleted slots are reused for free)
+        if (this->_growth_left == 0 && this->_ctrl[i] == EMPTY) {
+            size_type capacity = this->_size * 2 > _max_size_for(this->_capacity) ? this->_capacity * 2 : this->_capacity;
+            this->_resize(capacity);
+            i = this->_find_free(hash_code);
+        }
+
+        if (this->_ctrl[i] == EMPTY) --this->_growth_left;
+        new (this->_slots + i) value_type(std::forward<V>(value));
+        this->_set_ctrl(i, _h2(hash_code));
+        ++this->_size;
+
+        return std::pair<size_type,bool>(i, true);
+
+    }
+
+    void _erase_at(size_type i) {
+        this->_slots[i].~value_type();
+        this->_set_ctrl(i, DELETED);
+        --this->_size;
+    }
+
+    void _copy_content(const FlatUnorderedMap & other) {
+        this->_hash = other._hash;
+        this->_equal = other._equal;
+        this->_allocate(other._capacity);
+        for (size_type i = 0; i < other._capacity; ++i) {
+            if (other._ctrl[i] < 0) continue;
+            new (this->_slots + i) value_type(other._slots[i]);
+            this->_set_ctrl(i, other._ctrl[i]);
+        }
+        this->_size = other._size;
+        this->_growth_left = other._growth_left;
+    }
+
+    void _move_content(FlatUnorderedMap & src, FlatUnorderedMap & dst) {
+        dst._ctrl = src._ctrl;
+        dst._slots = src._slots;
+        dst._capacity = src._capacity;
+        dst._size = src._size;
+        dst._growth_left = src._growth_left;
+        dst._hash = src._hash;
+        dst._equal = src._equal;
+        dst._ctrl_alloc = src._ctrl_alloc;
+        dst._slot_alloc = src._slot_alloc;
+
+        // leave src as a valid empty table
+        src._allocate(GROUP_WIDTH);
+    }
+
+    public:
+
+    template <typename _value_type>
+    class basic_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = _value_type;
+        using difference_type = ptrdiff_t;
+        using pointer = value_type *;
+        using reference = value_type &;
+
+    private:
+        friend class FlatUnorderedMap<Key, T, Hash, key_equal, Allocator>;
+
+        const FlatUnorderedMap * _map;
+        size_type _index;
+        typename FlatUnorderedMap::value_type * _ptr;
+
+        explicit basic_iterator(FlatUnorderedMap const * map, size_type index) noexcept
+            : _map(map), _index(index), _ptr(index < map->_capacity ? map->_slots + index : nullptr) {}
+
+        // skip to the next full slot at or after _index, becoming end() past the last one
+        void _settle() {
+            while (this->_index < this->_map->_capacity && this->_map->_ctrl[this->_index] < 0) ++this->_index;
+            this->_ptr = this->_index < this->_map->_capacity ? this->_map->_slots + this->_index : nullptr;
+        }
+
+    public:
+        basic_iterator() : _map(nullptr), _index(0), _ptr(nullptr) {};
+
+        reference operator*() const { return *this->_ptr; }
+        pointer operator->() const { return this->_ptr; }
+
+        basic_iterator &operator++() {
+            if (this->_ptr == nullptr) return *this;
+            ++this->_index;
+            this->_settle();
+            return *this;
+        }
+        basic_iterator operator++(int) {
+            basic_iterator copy = *this;
+            ++(*this);
+            return copy;
+        }
+        bool operator==(const basic_iterator &other) const noexcept { return this->_ptr == other._ptr; }
+        bool operator!=(const basic_iterator &other) const noexcept { return this->_ptr != other._ptr; }
+    };
+
+    using iterator = basic_iterator<value_type>;
+    using const_iterator = basic_iterator<const value_type>;
+
+    explicit FlatUnorderedMap(size_type bucket_count = 0, const Hash & hash = Hash { },
+                const key_equal & equal = key_equal { }, const Allocator & alloc = Allocator { })
+                : _ctrl(nullptr), _slots(nullptr), _capacity(0),
+                _size(0), _growth_left(0), _hash(hash), _equal(equal), _ctrl_alloc(alloc), _slot_alloc(alloc) {
+
+                    // round up to a power of two that holds bucket_count entries
+                    this->_allocate(_capacity_for(bucket_count));
+
+                }
+
+    ~FlatUnorderedMap() {
+        this->_destroy_slots();
+        this->_deallocate();
+    }
+
+    FlatUnorderedMap(const FlatUnorderedMap & other) : _ctrl(nullptr), _slots(nullptr), _capacity(0),
+        _size(0), _growth_left(0), _hash(other._hash), _equal(other._equal),
+        _ctrl_alloc(ctrl_traits::select_on_container_copy_construction(other._ctrl_alloc)),
+        _slot_alloc(slot_traits::select_on_container_copy_construction(other._slot_alloc)) {
+        this->_copy_content(other);
+    }
+
+    FlatUnorderedMap(FlatUnorderedMap && other) : _ctrl(nullptr), _slots(nullptr), _capacity(0),
+        _size(0), _growth_left(0), _hash(other._hash), _equal(other._equal),
+        _ctrl_alloc(other._ctrl_alloc), _slot_alloc(other._slot_alloc) {
+        this->_move_content(other, *this);
+    }
+
+    FlatUnorderedMap & operator=(const FlatUnorderedMap & other) {
+        if (&other == this) return *this;
+        this->_destroy_slots();
+        this->_deallocate();
+        this->_copy_content(other);
+        return *this;
+    }
+
+    FlatUnorderedMap & operator=(FlatUnorderedMap && other) {
+        if (&other == this) return *this;
+        this->_destroy_slots();
+        this->_deallocate();
+        this->_move_content(other, *this);
+        return *this;
+    }
+
+    void clear() noexcept {
+        this->_destroy_slots();
+        std::memset(this->_ctrl, EMPTY, this->_capacity + GROUP_WIDTH);
+        this->_size = 0;
+        this->_growth_left = _max_size_for(this->_capacity);
+    }
+
+    size_type size() const noexcept { return this->_size; }
+
+    bool empty() const noexcept { return this->_size == 0; }
+
+    size_type bucket_count() const noexcept { return this->_capacity; }
+
+    /**
+        @brief Calls visit(n) once per group of GROUP_WIDTH slots with the number of them in use.
+    **/
+    template <typename F>
+    void for_each_bucket_size(F && visit) const {
+        for (size_type g = 0; g < this->_capacity; g += GROUP_WIDTH) {
+            size_type n = 0;
+            for (size_type i = g; i < g + GROUP_WIDTH && i < this->_capacity; ++i) n += this->_ctrl[i] >= 0;
+            visit(n);
+        }
+    }
+
+    /**
+        @brief Calls visit(n) once per entry with the number of groups a find for it scans.
+    **/
+    template <typename F>
+    void for_each_probe_length(F && visit) const {
+        size_type mask = this->_capacity - 1;
+        for (size_type i = 0; i < this->_capacity; ++i) {
+            if (this->_ctrl[i] < 0) continue;
+
+            // replay the probe sequence from the home position until a group covers slot i
+            size_type pos = _h1(this->_hash(this->_slots[i].first)) & mask;
+            size_type groups = 1;
+            for (size_type step = GROUP_WIDTH; ((i - pos) & mask) >= GROUP_WIDTH; step += GROUP_WIDTH, ++groups)
+                pos = (pos + step) & mask;
+            visit(groups);
+        }
+    }
+
+    float load_factor() const { return static_cast<float>(this->_size) / static_cast<float>(this->bucket_count()); }
+
+    // the probing scheme fixes the load limit at 7/8; the setter exists for API parity with UnorderedMap
+    float max_load_factor() const noexcept { return 0.875f; }
+    void max_load_factor(float) { }
+
+    /**
+        @brief Resizes to the smallest power-of-two capacity that holds max(count, size()) entries.
+
+        @param count the minimum number of entries.
+    **/
+    void rehash(size_type count) {
+        if (count < this->_size) count = this->_size;
+        this->_resize(_capacity_for(count));
+    }
+
+    void reserve(size_type count) { if (count > _max_size_for(this->_capacity)) this->rehash(count); }
+
+    iterator begin() {
+        iterator it(this, 0);
+        it._settle();
+        return it;
+    }
+    iterator end() { return iterator(); }
+
+    const_iterator cbegin() const {
+        const_iterator it(this, 0);
+        it._settle();
+        return it;
+    }
+    const_iterator cend() const { return const_iterator(); }
+
+    std::pair<iterator, bool> insert(value_type && value) {
+        std::pair<size_type,bool> result = this->_insert(std::move(value));
+        return std::pair<iterator,bool>(iterator(this, result.first), result.second);
+    }
+
+    std::pair<iterator, bool> insert(const value_type & value) {
+        std::pair<size_type,bool> result = this->_insert(value);
+        return std::pair<iterator,bool>(iterator(this, result.first), result.second);
+    }
+
+    // the same contract as UnorderedMap::insert_bulk, but serial: a probe sequence can cross any range of slots
+    template <typename V>
+    size_type insert_bulk(const V * values, size_type count, size_type threads = 0) {
+        this->reserve(this->_size + count);
+        size_type inserted = 0;
+        for (size_type i = 0; i < count; ++i) inserted += this->_insert(value_type(values[i])).second;
+        return inserted;
+    }
+
+    iterator find(const Key & key) {
+        return iterator(this, this->_find(key, this->_hash(key)));
+    }
+
+    const_iterator find(const Key & key) const { return const_iterator(this, this->_find(key, this->_hash(key))); }
+
+    // heterogeneous lookup when Hash and Pred are both transparent, e.g. a std::string_view
+    // or const char * against std::string keys, without building a Key
+    template <typename K, typename H = Hash, typename P = Pred,
+              typename = typename H::is_transparent, typename = typename P::is_transparent>
+    iterator find(const K & key) { return iterator(this, this->_find(key, this->_hash(key))); }
+
+    template <typename K, typename H = Hash, typename P = Pred,
+              typename = typename H::is_transparent, typename = typename P::is_transparent>
+    const_iterator find(const K & key) const { return const_iterator(this, this->_find(key, this->_hash(key))); }
+
+    bool contains(const Key & key) const { return this->_find(key, this->_hash(key)) != this->_capacity; }
+
+    template <typename K, typename H = Hash, typename P = Pred,
+              typename = typename H::is_transparent, typename = typename P::is_transparent>
+    bool contains(const K & key) const { return this->_find(key, this->_hash(key)) != this->_capacity; }
+
+    /**
+        @brief Looks up count keys at once, writing find(keys[i]) to out[i].
+
+        Every key in a group of BATCH_SIZE is hashed and its first control group
+        and slot prefetched before any probing starts, so the misses overlap.
+
+        @param keys the keys to look up; any type find() accepts.
+        @param count the number of keys.
+        @param out receives one iterator per key (end() when absent).
+    **/
+    template <typename K>
+    void find_batch(const K * keys, size_type count, iterator * out) { this->_find_batch(keys, count, out); }
+
+    template <typename K>
+    void find_batch(const K * keys, size_type count, const_iterator * out) const { this->_find_batch(keys, count, out); }
+
+    T& operator[](const Key & key) {
+        size_type i = this->_find(key, this->_hash(key));
+        if (i != this->_capacity) return this->_slots[i].second;
+        return this->_slots[this->_insert(value_type(key, mapped_type())).first].second;
+    }
+
+    iterator erase(iterator pos) {
+        if (pos == this->end()) return this->end();
+        iterator replacement = pos;
+        ++replacement;
+        this->_erase_at(pos._index);
+        return replacement;
+    }
+
+    size_type erase(const Key & key) {
+        size_type i = this->_find(key, this->_hash(key));
+        if (i == this->_capacity) return 0;
+        this->_erase_at(i);
+        return 1;
+    }
+};
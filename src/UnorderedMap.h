@@ -1,14 +1,25 @@
+#pragma once
+
+#include <algorithm>  // std::copy
 #include <cstddef>    // size_t
 #include <functional> // std::hash
 #include <ios>
 #include <utility>    // std::pair
 #include <iostream>
+#include <memory>     // std::allocator, std::allocator_traits
+#include <type_traits>
+#include <vector>
 
+#include "arena.h"
+#include "parallel.h"
+#include "prefetch.h"
 #include "primes.h"
+#include "range_hash.h"
 
 using std::cout;
 
-template <typename Key, typename T, typename Hash = std::hash<Key>, typename Pred = std::equal_to<Key>>
+template <typename Key, typename T, typename Hash = std::hash<Key>, typename Pred = std::equal_to<Key>,
+          typename RangeHash = prime_fastmod_range, typename Allocator = std::allocator<std::pair<const Key, T>>>
 class UnorderedMap {
     public:
 
@@ -17,6 +28,8 @@ class UnorderedMap {
     using const_mapped_type = const T;
     using hasher = Hash;
     using key_equal = Pred;
+    using range_hasher = RangeHash;
+    using allocator_type = Allocator;
     using value_type = std::pair<const key_type, mapped_type>;
     using reference = value_type &;
     using const_reference = const value_type &;
@@ -31,23 +44,48 @@ class UnorderedMap {
         HashNode *next;
         value_type val;
 
-        HashNode(HashNode *next = nullptr) : next{next} {}
+        HashNode(HashNode *next = nullptr) : next{next}, val() {}
         HashNode(const value_type & val, HashNode * next = nullptr) : next { next }, val { val } { }
         HashNode(value_type && val, HashNode * next = nullptr) : next { next }, val { std::move(val) } { }
+
+        // nodes are linked by address, never copied
+        HashNode(const HashNode &) = delete;
+        HashNode & operator=(const HashNode &) = delete;
     };
 
+    // nodes and bucket arrays both come from Allocator, rebound to their own types
+    using node_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<HashNode>;
+    using node_traits = std::allocator_traits<node_allocator>;
+    using bucket_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<HashNode*>;
+    using bucket_traits = std::allocator_traits<bucket_allocator>;
+
+    // with a no-op deallocate and nothing to destroy, clear() can drop nodes without visiting them
+    static constexpr bool TRIVIAL_TEARDOWN =
+        is_monotonic_allocator<Allocator>::value && std::is_trivially_destructible<value_type>::value;
+
+    // number of old buckets moved into the new array per insert/erase while growing
+    static constexpr size_type MIGRATE_STEP = 4;
+
+    // number of keys find_batch keeps in flight between prefetch passes
+    static constexpr size_type BATCH_SIZE = 16;
+
     size_type _bucket_count;
     HashNode **_buckets;
+    RangeHash _range;
+
+    // while growing, the previous bucket array; buckets below _migrated have already been moved
+    size_type _old_bucket_count;
+    HashNode **_old_buckets;
+    RangeHash _old_range;
+    size_type _migrated;
 
-    HashNode * _head;
     size_type _size;
+    float _max_load_factor;
 
     Hash _hash;
     key_equal _equal;
-
-    static size_type _range_hash(size_type hash_code, size_type bucket_count) {
-        return hash_code % bucket_count;
-    }
+    node_allocator _node_alloc;
+    bucket_allocator _bucket_alloc;
 
     public:
 
@@ -61,8 +99,8 @@ class UnorderedMap {
         using reference = value_type &;
 
     private:
-        friend class UnorderedMap<Key, T, Hash, key_equal>;
-        using HashNode = typename UnorderedMap<Key, T, Hash, key_equal>::HashNode;
+        friend class UnorderedMap<Key, T, Hash, key_equal, RangeHash, Allocator>;
+        using HashNode = typename UnorderedMap<Key, T, Hash, key_equal, RangeHash, Allocator>::HashNode;
 
         const UnorderedMap * _map;
         HashNode * _ptr;
@@ -86,16 +124,12 @@ class UnorderedMap {
             // if there's a next node in the same bucket, return it first
             if (this->_ptr->next != nullptr) return this->_ptr->next;
 
-            // find current bucket index and scan subsequent buckets for a non-empty head
-            size_type b = this->_map->_bucket(this->_ptr->val.first);
-            for (size_type i = b + 1; i < this->_map->_bucket_count; ++i) {
-                if (this->_map->_buckets[i] != nullptr) return this->_map->_buckets[i];
-            }
-            return nullptr;
+            // otherwise scan the following buckets for a non-empty head
+            return this->_map->_next_head(this->_ptr);
         }
 
         basic_iterator &operator++() { this->_ptr = this->increment(); return *this;}
-        basic_iterator operator++(int) { 
+        basic_iterator operator++(int) {
             basic_iterator copy = *this;
             this->_ptr = this->increment();
             return copy;
@@ -116,8 +150,8 @@ class UnorderedMap {
             using reference = value_type &;
 
         private:
-            friend class UnorderedMap<Key, T, Hash, key_equal>;
-            using HashNode = typename UnorderedMap<Key, T, Hash, key_equal>::HashNode;
+            friend class UnorderedMap<Key, T, Hash, key_equal, RangeHash, Allocator>;
+            using HashNode = typename UnorderedMap<Key, T, Hash, key_equal, RangeHash, Allocator>::HashNode;
 
             HashNode * _node;
 
@@ -133,12 +167,12 @@ class UnorderedMap {
             local_iterator &operator=(local_iterator &&) = default;
             reference operator*() const { return this->_node->val; }
             pointer operator->() const { return &(this->_node->val); }
-            local_iterator & operator++() { 
+            local_iterator & operator++() {
                 if (this->_node == nullptr) this->_node = nullptr;
-                else this->_node = this->_node->next; 
-                return *this; 
+                else this->_node = this->_node->next;
+                return *this;
             }
-            local_iterator operator++(int) { 
+            local_iterator operator++(int) {
                 local_iterator copy = *this;
                 if (this->_node == nullptr) this->_node = nullptr;
                 else this->_node = this->_node->next;
@@ -151,14 +185,45 @@ class UnorderedMap {
 
 private:
 
-    size_type _bucket(size_t code) const { return _range_hash(code,this->_bucket_count); }
-    size_type _bucket(const Key & key) const { return _bucket(_hash(key)); }
-    size_type _bucket(const value_type & val) const { return _bucket(_hash(val.first)); }
+    size_type _code_bucket(size_t code) const { return this->_range(code); }
+    size_type _bucket(const Key & key) const { return _code_bucket(_hash(key)); }
+    size_type _bucket(const value_type & val) const { return _code_bucket(_hash(val.first)); }
+
+    size_type _old_bucket(size_t code) const { return this->_old_range(code); }
+
+    bool _migrating() const noexcept { return this->_old_buckets != nullptr; }
+
+    // first non-empty bucket head at or after index b of the new array, then of the unmigrated old buckets
+    HashNode* _first_head(size_type b) const {
+        for (size_type i = b; i < this->_bucket_count; ++i)
+            if (this->_buckets[i] != nullptr) return this->_buckets[i];
+        return this->_first_old_head(this->_migrated);
+    }
+
+    HashNode* _first_old_head(size_type b) const {
+        if (!this->_migrating()) return nullptr;
+        for (size_type i = b; i < this->_old_bucket_count; ++i)
+            if (this->_old_buckets[i] != nullptr) return this->_old_buckets[i];
+        return nullptr;
+    }
+
+    // head of the bucket following the one that ends with node, in iteration order
+    HashNode* _next_head(HashNode* node) const {
+
+        size_t code = this->_hash(node->val.first);
+        size_type b = this->_code_bucket(code);
+        if (!this->_migrating()) return this->_first_head(b + 1);
 
-    HashNode* _find(size_type bucket, const Key & key) {
+        // the node lives in the new array only if it is on that bucket's chain
+        for (HashNode* current = this->_buckets[b]; current != nullptr; current = current->next)
+            if (current == node) return this->_first_head(b + 1);
 
-        // get the first node of bucket 
-        HashNode* current = this->_buckets[bucket];
+        return this->_first_old_head(this->_old_bucket(code) + 1);
+
+    }
+
+    template <typename K>
+    HashNode* _find_in_chain(HashNode* current, const K & key) const {
 
         // iterate through until key is reached
         while (current != nullptr) {
@@ -170,212 +235,350 @@ private:
 
     }
 
-    HashNode* _find(const Key & key) {
+    template <typename K>
+    HashNode* _find(size_t code, const K & key) const {
 
-        // get the bucket index
-        size_type bucket = this->_bucket(key);
+        // check the current bucket array first
+        HashNode* node = this->_find_in_chain(this->_buckets[this->_code_bucket(code)], key);
+        if (node != nullptr) return node;
 
-        // iterate through until key is reached
-        return this->_find(bucket,key);
+        // then the old bucket
+        return this->_find_old(code, key);
 
     }
 
-    std::pair<HashNode*,HashNode*> _find_previous_and_target(const Key & key) {
+    // find_batch for either iterator type
+    template <typename K, typename It>
+    void _find_batch(const K * keys, size_type count, It * out) const {
 
-        // get the bucket index
-        size_type bucket = this->_bucket(key);
+        size_t codes[BATCH_SIZE];
+        HashNode* const * slots[BATCH_SIZE];
+        HashNode* heads[BATCH_SIZE];
 
-        // get the first node of bucket
-        HashNode* previous = nullptr;
-        HashNode* current = this->_buckets[bucket];
+        for (size_type base = 0; base < count; base += BATCH_SIZE) {
+            size_type n = count - base < BATCH_SIZE ? count - base : BATCH_SIZE;
 
-        // iterate through until key is reached
-        while (current != nullptr) {
-            if (this->_equal(current->val.first,key)) return std::pair<HashNode*,HashNode*>(previous,current);
-            previous = current;
-            current = current->next;
+            // hash the group and prefetch its bucket slots
+            for (size_type i = 0; i < n; ++i) {
+                codes[i] = this->_hash(keys[base + i]);
+                slots[i] = this->_buckets + this->_code_bucket(codes[i]);
+                MAP_PREFETCH(slots[i]);
+            }
+
+            // load the bucket heads and prefetch the first nodes
+            for (size_type i = 0; i < n; ++i) {
+                heads[i] = *slots[i];
+                if (heads[i] != nullptr) MAP_PREFETCH(heads[i]);
+            }
+
+            // walk the chains
+            for (size_type i = 0; i < n; ++i) {
+                HashNode* node = this->_find_in_chain(heads[i], keys[base + i]);
+                if (node == nullptr) node = this->_find_old(codes[i], keys[base + i]);
+                out[base + i] = It(this,node);
+            }
         }
 
-        return std::pair<HashNode*,HashNode*>(nullptr,nullptr);
+    }
+
+    template <typename K>
+    HashNode* _find_old(size_t code, const K & key) const {
+
+        // only buckets that have not been moved yet can hold the key
+        if (!this->_migrating()) return nullptr;
+        size_type old = this->_old_bucket(code);
+        if (old < this->_migrated) return nullptr;
+        return this->_find_in_chain(this->_old_buckets[old], key);
 
     }
 
-    HashNode * _insert_into_bucket(size_type bucket, value_type && value) {
+    template <typename K>
+    HashNode* _find(const K & key) const {
 
-        // cover bucket head
-        HashNode* old_head = this->_buckets[bucket];                    
-        HashNode* new_head = new HashNode(std::move(value),old_head);   
-        this->_buckets[bucket] = new_head;                              
+        // hash once and search
+        return this->_find(this->_hash(key),key);
 
-        // cover global head
-        if (this->_head == nullptr || this->_bucket(this->_head->val.first) >= this->_bucket(new_head->val.first)) 
-            this->_head = new_head;
+    }
 
-        ++this->_size;
+    // address of the pointer that links to key's node (a bucket slot or a previous node's next)
+    template <typename K>
+    HashNode** _find_link(const K & key) {
 
-        return new_head;
+        size_t code = this->_hash(key);
+
+        HashNode** link = &this->_buckets[this->_code_bucket(code)];
+        while (*link != nullptr) {
+            if (this->_equal((*link)->val.first,key)) return link;
+            link = &(*link)->next;
+        }
+
+        if (!this->_migrating()) return nullptr;
+        size_type old = this->_old_bucket(code);
+        if (old < this->_migrated) return nullptr;
+
+        link = &this->_old_buckets[old];
+        while (*link != nullptr) {
+            if (this->_equal((*link)->val.first,key)) return link;
+            link = &(*link)->next;
+        }
+
+        return nullptr;
 
     }
 
-    HashNode * _insert_into_bucket(size_type bucket, const value_type & value) {
+    template <typename V>
+    HashNode * _insert_into_bucket(size_type bucket, V && value) {
 
         // cover bucket head
-        HashNode* old_head = this->_buckets[bucket];                    
-        HashNode* new_head = new HashNode(value,old_head);   
-        this->_buckets[bucket] = new_head;                              
-
-        // cover global head
-        if (this->_head == nullptr || this->_bucket(this->_head->val.first) >= this->_bucket(new_head->val.first)) 
-            this->_head = new_head;
+        HashNode* old_head = this->_buckets[bucket];
+        HashNode* new_head = this->_new_node(std::forward<V>(value),old_head);
+        this->_buckets[bucket] = new_head;
 
         ++this->_size;
 
         return new_head;
 
     }
-    
+
+    template <typename V>
+    HashNode* _new_node(V && value, HashNode* next) {
+        HashNode* node = node_traits::allocate(this->_node_alloc, 1);
+        node_traits::construct(this->_node_alloc, node, std::forward<V>(value), next);
+        return node;
+    }
+
+    void _delete_node(HashNode* node) noexcept {
+        node_traits::destroy(this->_node_alloc, node);
+        node_traits::deallocate(this->_node_alloc, node, 1);
+    }
+
+    HashNode** _allocate_buckets(size_type count) {
+        HashNode** buckets = bucket_traits::allocate(this->_bucket_alloc, count);
+        for (size_type i = 0; i < count; ++i) buckets[i] = nullptr;
+        return buckets;
+    }
+
+    void _deallocate_buckets(HashNode** buckets, size_type count) noexcept {
+        if (buckets != nullptr) bucket_traits::deallocate(this->_bucket_alloc, buckets, count);
+    }
+
+    // move up to count old buckets into the new array by relinking their nodes
+    void _migrate(size_type count) {
+
+        if (!this->_migrating()) return;
+
+        size_type end = this->_migrated + count;
+        if (end > this->_old_bucket_count) end = this->_old_bucket_count;
+
+        for (; this->_migrated < end; ++this->_migrated) {
+            HashNode* current = this->_old_buckets[this->_migrated];
+            while (current != nullptr) {
+                HashNode* next = current->next;
+                size_type b = this->_bucket(current->val.first);
+                current->next = this->_buckets[b];
+                this->_buckets[b] = current;
+                current = next;
+            }
+            this->_old_buckets[this->_migrated] = nullptr;
+        }
+
+        // release the old array once everything has moved
+        if (this->_migrated == this->_old_bucket_count) {
+            this->_deallocate_buckets(this->_old_buckets, this->_old_bucket_count);
+            this->_old_buckets = nullptr;
+            this->_old_bucket_count = 0;
+            this->_migrated = 0;
+        }
+
+    }
+
+    void _finish_migration() { this->_migrate(this->_old_bucket_count); }
+
+    // swap in a new bucket array; nodes are moved over by later calls to _migrate
+    void _start_rehash(size_type bucket_count) {
+
+        this->_finish_migration();
+
+        this->_old_buckets = this->_buckets;
+        this->_old_bucket_count = this->_bucket_count;
+        this->_old_range = this->_range;
+        this->_migrated = 0;
+
+        this->_bucket_count = RangeHash::size_for(bucket_count);
+        this->_buckets = this->_allocate_buckets(this->_bucket_count);
+        this->_range = RangeHash(this->_bucket_count);
+
+    }
+
+    // start growing when one more entry would push the load factor past the limit
+    void _grow_if_needed() {
+        float next = static_cast<float>(this->_size + 1) / static_cast<float>(this->_bucket_count);
+        if (next > this->_max_load_factor) this->_start_rehash(this->_bucket_count * 2);
+    }
+
+    void _delete_nodes(HashNode** buckets, size_type count) noexcept {
+
+        // nodes need neither destruction nor freeing, so just empty the buckets
+        if (TRIVIAL_TEARDOWN) {
+            for (size_type i = 0; i < count; ++i) buckets[i] = nullptr;
+            return;
+        }
+
+        // loop thru the buckets
+        for (size_type i = 0; i < count; ++i) {
+
+            // loop thru each bucket
+            HashNode* current = buckets[i];
+            while (current != nullptr) {
+                HashNode* next = current->next;     // get next
+                this->_delete_node(current);        // deallocate
+                current = next;                     // set current to next
+            }
+            buckets[i] = nullptr;
+
+        }
+
+    }
+
     void _move_content(UnorderedMap & src, UnorderedMap & dst) {
-        
+
         // move everything to dst
         dst._bucket_count = src._bucket_count;
-        dst._head = src._head;
         dst._buckets = src._buckets;
+        dst._range = src._range;
+        dst._old_bucket_count = src._old_bucket_count;
+        dst._old_buckets = src._old_buckets;
+        dst._old_range = src._old_range;
+        dst._migrated = src._migrated;
         dst._size = src._size;
+        dst._max_load_factor = src._max_load_factor;
         dst._hash = src._hash;
         dst._equal = src._equal;
+        dst._node_alloc = src._node_alloc;
+        dst._bucket_alloc = src._bucket_alloc;
 
         // set src to empty state
-        src._head = nullptr;
-        src._buckets = new HashNode*[src._bucket_count]();
+        src._buckets = src._allocate_buckets(src._bucket_count);
+        src._old_buckets = nullptr;
+        src._old_bucket_count = 0;
+        src._migrated = 0;
         src._size = 0;
 
     }
 
     void _copy_content(const UnorderedMap & other) {
 
-        // copy buckets
+        // copy into a single bucket array the size of other's current one
         this->_bucket_count = other._bucket_count;
-        this->_buckets = new HashNode*[this->_bucket_count];
-        for (size_type i = 0; i < _bucket_count; ++i) {
-
-            // create the head
-            HashNode* c = other._buckets[i];
-            if (c == nullptr) { this->_buckets[i] = nullptr; continue; }
-            HashNode* p = new HashNode(c->val,nullptr);
-            this->_buckets[i] = p;
-
-            // create the linked list
-            while (c->next != nullptr) {
-
-                // increment c
-                c = c->next;
-
-                // create new node and update pointers
-                HashNode* new_node = new HashNode(c->val,nullptr);
-                p->next = new_node;
-
-                // increment p
-                p = new_node;
-
-            }
-        }
-
-        // set the rest of the variables
-        this->_head = nullptr;
-        for (size_type i = 0; i < _bucket_count; ++i) 
-            if (this->_buckets[i] != nullptr) { this->_head = this->_buckets[i]; break; }
-        this->_size = other._size;
+        this->_buckets = this->_allocate_buckets(this->_bucket_count);
+        this->_range = other._range;
+        this->_old_buckets = nullptr;
+        this->_old_bucket_count = 0;
+        this->_migrated = 0;
+        this->_size = 0;
+        this->_max_load_factor = other._max_load_factor;
         this->_hash = other._hash;
         this->_equal = other._equal;
 
+        // rehash every node, including any still in other's old array
+        for (HashNode* node = other._first_head(0); node != nullptr; ) {
+            this->_insert_into_bucket(this->_bucket(node->val.first), node->val);
+            node = node->next != nullptr ? node->next : other._next_head(node);
+        }
+
     }
 
 public:
     explicit UnorderedMap(size_type bucket_count, const Hash & hash = Hash { },
-                const key_equal & equal = key_equal { }) : _head(nullptr), _size(0), _hash(hash), _equal(equal) {
+                const key_equal & equal = key_equal { }, const Allocator & alloc = Allocator { })
+                : _bucket_count(0), _buckets(nullptr), _range(),
+                _old_bucket_count(0), _old_buckets(nullptr), _old_range(), _migrated(0),
+                _size(0), _max_load_factor(1.0f), _hash(hash), _equal(equal),
+                _node_alloc(alloc), _bucket_alloc(alloc) {
 
-                    // make sure _bucket_count is prime
-                    _bucket_count = next_greater_prime(bucket_count);
+                    // round _bucket_count up to a size the range policy supports (a prime by default)
+                    _bucket_count = RangeHash::size_for(bucket_count);
+                    _range = RangeHash(_bucket_count);
 
                     // create the array of bucket nodes
-                    _buckets = new HashNode*[_bucket_count];
-                    for(size_type i = 0; i < _bucket_count; ++i) _buckets[i] = nullptr;
+                    _buckets = this->_allocate_buckets(_bucket_count);
 
                 }
 
     ~UnorderedMap() {
         this->clear();
-        delete _buckets;
+        this->_deallocate_buckets(_buckets, _bucket_count);
     }
 
-    UnorderedMap(const UnorderedMap & other) { 
-        this->_copy_content(other); 
+    UnorderedMap(const UnorderedMap & other) : _bucket_count(0), _buckets(nullptr), _range(),
+        _old_bucket_count(0), _old_buckets(nullptr), _old_range(), _migrated(0),
+        _size(0), _max_load_factor(1.0f), _hash(other._hash), _equal(other._equal),
+        _node_alloc(node_traits::select_on_container_copy_construction(other._node_alloc)),
+        _bucket_alloc(bucket_traits::select_on_container_copy_construction(other._bucket_alloc)) {
+        this->_copy_content(other);
     }
 
-    UnorderedMap(UnorderedMap && other) { 
-        this->_move_content(other,*this); 
+    UnorderedMap(UnorderedMap && other) : _bucket_count(0), _buckets(nullptr), _range(),
+        _old_bucket_count(0), _old_buckets(nullptr), _old_range(), _migrated(0),
+        _size(0), _max_load_factor(1.0f), _hash(other._hash), _equal(other._equal),
+        _node_alloc(other._node_alloc), _bucket_alloc(other._bucket_alloc) {
+        this->_move_content(other,*this);
     }
 
-    UnorderedMap & operator=(const UnorderedMap & other) { 
+    // copy assignment rebuilds other's nodes with this map's allocator; move assignment takes other's allocator with its nodes
+    UnorderedMap & operator=(const UnorderedMap & other) {
         if (&other == this) return *this;
-        this->clear(); 
-        delete _buckets;
-        this->_copy_content(other); 
-        return *this; 
+        this->clear();
+        this->_deallocate_buckets(_buckets, _bucket_count);
+        this->_copy_content(other);
+        return *this;
     }
 
-    UnorderedMap & operator=(UnorderedMap && other) { 
+    UnorderedMap & operator=(UnorderedMap && other) {
         if (&other == this) return *this;
         this->clear();
-        delete _buckets;
+        this->_deallocate_buckets(_buckets, _bucket_count);
         this->_move_content(other, *this);
         return *this;
     }
 
     void clear() noexcept {
 
-        if (!this->empty()) {
-            
-            // loop thru the buckets
-            for (size_type i = 0; i < this->_bucket_count; ++i) {
-
-                // loop thru each bucket
-                HashNode* current = this->_buckets[i];
-                while (current != nullptr) {
-                    HashNode* next = current->next;     // get next
-                    delete current;                     // deallocate
-                    current = next;                     // set current to next
-                }
-
-            }
+        if (!this->empty()) this->_delete_nodes(this->_buckets, this->_bucket_count);
 
+        // drop any pending migration
+        if (this->_migrating()) {
+            this->_delete_nodes(this->_old_buckets, this->_old_bucket_count);
+            this->_deallocate_buckets(this->_old_buckets, this->_old_bucket_count);
+            this->_old_buckets = nullptr;
+            this->_old_bucket_count = 0;
+            this->_migrated = 0;
         }
 
         // update internals
-        for(size_type i = 0; i < _bucket_count; i++) _buckets[i] = nullptr;
-        this->_head = nullptr;
         this->_size = 0;
 
     }
 
     size_type size() const noexcept { return this->_size; }
 
-    bool empty() const noexcept { return (this->_size == 0 && this->_head == nullptr); }
+    bool empty() const noexcept { return this->_size == 0; }
 
     size_type bucket_count() const noexcept { return this->_bucket_count; }
 
-    iterator begin() { 
+    iterator begin() {
         if (this->_size == 0) return iterator(this,nullptr);
-        return iterator(this,this->_head); 
+        return iterator(this,this->_first_head(0));
     }
     iterator end() { return iterator(this,nullptr); }
 
-    const_iterator cbegin() const { 
+    const_iterator cbegin() const {
         if (this->_size == 0) return const_iterator(this,nullptr);
-        return const_iterator(this,this->_head); 
+        return const_iterator(this,this->_first_head(0));
     };
     const_iterator cend() const { return const_iterator(this,nullptr); }
 
+    // local iteration only sees the current bucket array; call rehash() first to settle a pending migration
     local_iterator begin(size_type n) { return local_iterator(this->_buckets[n]); }
     local_iterator end(size_type n) { return local_iterator(nullptr); }
 
@@ -385,43 +588,225 @@ public:
         return count;
     }
 
+    /**
+        @brief Calls visit(n) once per bucket with the number of entries chained there,
+        including the buckets a pending migration has not moved yet.
+    **/
+    template <typename F>
+    void for_each_bucket_size(F && visit) const {
+        auto length = [](const HashNode * node) {
+            size_type count = 0;
+            for (; node != nullptr; node = node->next) ++count;
+            return count;
+        };
+        for (size_type b = 0; b < this->_bucket_count; ++b) visit(length(this->_buckets[b]));
+        for (size_type b = this->_migrated; this->_old_buckets != nullptr && b < this->_old_bucket_count; ++b)
+            visit(length(this->_old_buckets[b]));
+    }
+
+    /**
+        @brief Calls visit(n) once per entry with the number of nodes a find for it compares.
+    **/
+    template <typename F>
+    void for_each_probe_length(F && visit) const {
+        this->for_each_bucket_size([&visit](size_type n) { for (size_type k = 1; k <= n; ++k) visit(k); });
+    }
+
     float load_factor() const { return static_cast<float>(this->_size) / static_cast<float>(this->bucket_count()); }
 
+    float max_load_factor() const noexcept { return this->_max_load_factor; }
+
+    /**
+        @brief Sets the load factor above which an insert starts growing the bucket array.
+
+        @param ml the new limit; growth starts on the next insert if the map is already past it.
+    **/
+    void max_load_factor(float ml) { if (ml > 0.0f) this->_max_load_factor = ml; }
+
+    /**
+        @brief Rebuilds the bucket array with at least count buckets (and enough for the
+        current size under max_load_factor), moving every node before returning.
+
+        @param count the minimum number of buckets.
+    **/
+    void rehash(size_type count) {
+        size_type needed = static_cast<size_type>(static_cast<float>(this->_size) / this->_max_load_factor);
+        if (count < needed) count = needed;
+
+        if (RangeHash::size_for(count) != this->_bucket_count) this->_start_rehash(count);
+        this->_finish_migration();
+    }
+
+    /**
+        @brief Sizes the bucket array so count entries fit without further growth. Never
+        shrinks it; a rehash already under way is finished either way.
+
+        @param count the expected number of entries.
+    **/
+    void reserve(size_type count) {
+        size_type buckets = static_cast<size_type>(static_cast<float>(count) / this->_max_load_factor + 1.0f);
+        if (RangeHash::size_for(buckets) > this->_bucket_count) this->_start_rehash(buckets);
+        this->_finish_migration();
+    }
+
     size_type bucket(const Key & key) const { return this->_bucket(key); }
 
-    std::pair<iterator, bool> insert(value_type && value) { 
-        size_type bucket = _bucket(value.first);
-        
+    std::pair<iterator, bool> insert(value_type && value) {
+        this->_migrate(MIGRATE_STEP);
+        size_t code = _hash(value.first);
+
         // check if the value exists
-        HashNode * node = _find(bucket, value.first);
+        HashNode * node = _find(code, value.first);
         if (node != nullptr) return std::pair<iterator,bool>(iterator(this,node),false);
 
-        // if not, then create the new hash node
-        node = this->_insert_into_bucket(bucket,std::move(value));
+        // if not, then grow if needed and create the new hash node
+        this->_grow_if_needed();
+        node = this->_insert_into_bucket(_code_bucket(code),std::move(value));
 
         return std::pair<iterator,bool>(iterator(this,node),true);
     }
 
-    std::pair<iterator, bool> insert(const value_type & value) { 
-        size_type bucket = _bucket(value.first);
-        
+    std::pair<iterator, bool> insert(const value_type & value) {
+        this->_migrate(MIGRATE_STEP);
+        size_t code = _hash(value.first);
+
         // check if the value exists
-        HashNode * node = _find(bucket, value.first);
+        HashNode * node = _find(code, value.first);
         if (node != nullptr) { return std::pair<iterator,bool>(iterator(this,node),false); }
 
-        // if not, then create the new hash node
-        node = this->_insert_into_bucket(bucket,value);
+        // if not, then grow if needed and create the new hash node
+        this->_grow_if_needed();
+        node = this->_insert_into_bucket(_code_bucket(code),value);
 
         return std::pair<iterator,bool>(iterator(this,node),true);
     }
 
-    iterator find(const Key & key) { 
+    /**
+        @brief Inserts count values as count calls to insert() would, keeping the first of any
+        repeated key. Nodes are allocated on the calling thread. Hashing and linking them into
+        the buckets, the part that misses the cache, runs on up to threads threads, each owning
+        a contiguous range of buckets, so no two threads touch the same chain.
+
+        @param values the values to insert.
+        @param count the number of values.
+        @param threads how many threads to use, the calling one included; 0 means one per core.
+        @return the number of values inserted.
+    **/
+    template <typename V>
+    size_type insert_bulk(const V * values, size_type count, size_type threads = 0) {
+
+        // size the table up front, so the bucket of every key is fixed while threads link
+        this->reserve(this->_size + count);
+        threads = parallel_threads(threads, count, 1u << 14);
+
+        std::vector<HashNode*> nodes(count);
+        for (size_type i = 0; i < count; ++i) nodes[i] = this->_new_node(value_type(values[i]), nullptr);
+
+        // hash every key once, keeping its bucket, and count how many of each thread's nodes each thread owns;
+        // counts[t * threads + u] is thread t's count for owner u, kept in a local array until the pass ends
+        // so threads never write next to each other
+        size_type bucket_count = this->_bucket_count;
+        std::vector<size_type> buckets(count);
+        std::vector<size_type> counts(threads * threads, 0);
+        parallel_for(threads, [&](size_t t) {
+            std::vector<size_type> local(threads, 0);
+            for (size_type i = count * t / threads; i < count * (t + 1) / threads; ++i) {
+                buckets[i] = this->_bucket(nodes[i]->val.first);
+                ++local[buckets[i] * threads / bucket_count];
+            }
+            std::copy(local.begin(), local.end(), counts.begin() + t * threads);
+        });
+
+        // turn the counts into where each thread writes its nodes for each owner, keeping input order
+        size_type offset = 0;
+        std::vector<size_type> starts(threads + 1, 0);
+        for (size_type u = 0; u < threads; ++u) {
+            starts[u] = offset;
+            for (size_type t = 0; t < threads; ++t) {
+                size_type n = counts[t * threads + u];
+                counts[t * threads + u] = offset;
+                offset += n;
+            }
+        }
+        starts[threads] = offset;
+
+        std::vector<std::pair<HashNode*, size_type>> order(count);
+        parallel_for(threads, [&](size_t t) {
+            std::vector<size_type> next(counts.begin() + t * threads, counts.begin() + (t + 1) * threads);
+            for (size_type i = count * t / threads; i < count * (t + 1) / threads; ++i)
+                order[next[buckets[i] * threads / bucket_count]++] = std::make_pair(nodes[i], buckets[i]);
+        });
+
+        // each thread links its own buckets, and sets aside any node whose key is already on the chain
+        std::vector<std::vector<HashNode*>> duplicates(threads);
+        parallel_for(threads, [&](size_t u) {
+            std::vector<HashNode*> skipped;
+            for (size_type i = starts[u]; i < starts[u + 1]; ++i) {
+                HashNode * node = order[i].first;
+                size_type b = order[i].second;
+                if (this->_find_in_chain(this->_buckets[b], node->val.first) != nullptr) {
+                    skipped.push_back(node);
+                    continue;
+                }
+                node->next = this->_buckets[b];
+                this->_buckets[b] = node;
+            }
+            duplicates[u] = std::move(skipped);
+        });
+
+        size_type total = count;
+        for (const std::vector<HashNode*> & skipped : duplicates) {
+            for (HashNode * node : skipped) this->_delete_node(node);
+            total -= skipped.size();
+        }
+        this->_size += total;
+        return total;
+
+    }
+
+    iterator find(const Key & key) {
         HashNode* node = this->_find(key);
         if (node != nullptr) return iterator(this,node);
         return iterator(this,nullptr);
     }
 
-    T& operator[](const Key & key) { 
+    const_iterator find(const Key & key) const { return const_iterator(this,this->_find(key)); }
+
+    // heterogeneous lookup when Hash and Pred are both transparent, e.g. a std::string_view
+    // or const char * against std::string keys, without building a Key
+    template <typename K, typename H = Hash, typename P = Pred,
+              typename = typename H::is_transparent, typename = typename P::is_transparent>
+    iterator find(const K & key) { return iterator(this,this->_find(key)); }
+
+    template <typename K, typename H = Hash, typename P = Pred,
+              typename = typename H::is_transparent, typename = typename P::is_transparent>
+    const_iterator find(const K & key) const { return const_iterator(this,this->_find(key)); }
+
+    bool contains(const Key & key) const { return this->_find(key) != nullptr; }
+
+    template <typename K, typename H = Hash, typename P = Pred,
+              typename = typename H::is_transparent, typename = typename P::is_transparent>
+    bool contains(const K & key) const { return this->_find(key) != nullptr; }
+
+    /**
+        @brief Looks up count keys at once, writing find(keys[i]) to out[i].
+
+        Keys are processed in groups: every key in a group is hashed and its bucket
+        slot prefetched, then every bucket head is loaded and prefetched, and only
+        then are the chains compared, so the cache misses of a group overlap
+        instead of being paid one key at a time.
+
+        @param keys the keys to look up; any type find() accepts.
+        @param count the number of keys.
+        @param out receives one iterator per key (end() when absent).
+    **/
+    template <typename K>
+    void find_batch(const K * keys, size_type count, iterator * out) { this->_find_batch(keys, count, out); }
+
+    template <typename K>
+    void find_batch(const K * keys, size_type count, const_iterator * out) const { this->_find_batch(keys, count, out); }
+
+    T& operator[](const Key & key) {
 
         // check if the key exists
         HashNode* node = this->_find(key);
@@ -435,9 +820,9 @@ public:
 
     iterator erase(iterator pos) {
 
-        // check if pos is invalid 
+        // check if pos is invalid
         if (pos == this->end()) return this->end();
-        
+
         // find target & check for nullptr
         HashNode* t = pos._ptr;
         if (t == nullptr) return this->end();
@@ -446,24 +831,12 @@ public:
         iterator replacement = pos;
         ++replacement;
 
-        // get previous & next
-        size_type bucket = this->_bucket(t->val.first);
-        std::pair<HashNode*,HashNode*> node_pair = this->_find_previous_and_target(pos->first);
-        HashNode* p = node_pair.first;
-        HashNode* n = t->next;
-
-        // if p is nullptr, then we are removing the bucket head
-        if (p == nullptr) this->_buckets[bucket] = n;
-        else p->next = n;
-
-        // if target is the global head
-        if (this->_head == t) {
-            if (n != nullptr) this->_head = n;
-            else this->_head = replacement._ptr;
-        }
+        // unlink the target from whichever chain holds it
+        HashNode** link = this->_find_link(t->val.first);
+        *link = t->next;
 
         // delete & update pointers
-        delete t;
+        this->_delete_node(t);
         t = nullptr;
         --this->_size;
 
@@ -473,31 +846,19 @@ public:
 
     size_type erase(const Key & key) {
 
-        // find bucket
-        size_type bucket = this->_bucket(key);
-
-        // find target, previous, and next nodes
-        std::pair<HashNode*,HashNode*> node_pair = this->_find_previous_and_target(key);
-        HashNode* p = node_pair.first;
-        HashNode* t = node_pair.second;
-        HashNode* n = t != nullptr ? t->next : nullptr;
+        this->_migrate(MIGRATE_STEP);
 
-        // check the nodes
-        if (t == nullptr) return 0;
+        // find the link to the target
+        HashNode** link = this->_find_link(key);
+        if (link == nullptr) return 0;
 
-        // delete & update pointers
-        delete t;
+        // unlink, delete & update pointers
+        HashNode* t = *link;
+        *link = t->next;
+        this->_delete_node(t);
         t = nullptr;
         --this->_size;
 
-        // check if target is the bucket head or map head
-        if (p != nullptr)
-            p->next = n;
-        else if (this->_head == nullptr)
-            this->_head = n;
-        else
-            this->_buckets[bucket] = n;
-
         return 1;
 
     }
@@ -523,4 +884,18 @@ void print_map(const UnorderedMap<K, V> & map, std::ostream & os = std::cout) {
 
         os << std::endl;
     }
+
+    // buckets still waiting to be moved by an in-progress rehash
+    for(size_type bucket = map._migrated; map._old_buckets != nullptr && bucket < map._old_bucket_count; bucket++) {
+        os << "old " << bucket << ": ";
+
+        HashNode const * node = map._old_buckets[bucket];
+
+        while(node) {
+            os << "(" << node->val.first << ", " << node->val.second << ") ";
+            node = node->next;
+        }
+
+        os << std::endl;
+    }
 }
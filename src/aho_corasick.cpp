@@ -0,0 +1,207 @@
+#include "aho_corasick.h"
+
+#include <algorithm>
+#include <utility>
+
+static inline unsigned char _fold(unsigned char c) {
+    return static_cast<unsigned char>(c - 'A') < 26 ? static_cast<unsigned char>(c | 0x20) : c;
+}
+
+aho_corasick::aho_corasick(bool ignore_case) : _patterns(), _slots(1, _slot { 0, -1, 0, -1 }), _table(), _classes(),
+    _class_count(1), _states(1), _ignore_case(ignore_case) {}
+
+void aho_corasick::build() {
+
+    // number the distinct bytes; everything else is class 0
+    std::fill(std::begin(this->_classes), std::end(this->_classes), 0);
+    this->_class_count = 1;
+    for (const std::string & pattern : this->_patterns) {
+        for (char ch : pattern) {
+            unsigned char c = static_cast<unsigned char>(ch);
+            if (this->_ignore_case) c = _fold(c);
+            if (this->_classes[c] == 0) this->_classes[c] = static_cast<uint16_t>(this->_class_count++);
+        }
+    }
+    if (this->_ignore_case)
+        for (int c = 'A'; c <= 'Z'; ++c) this->_classes[c] = this->_classes[c | 0x20];
+
+    // the plain trie first; children are (class, node) pairs
+    struct trie_node {
+        std::vector<std::pair<uint16_t, int32_t>> children;
+        int32_t pattern;
+    };
+    std::vector<trie_node> trie(1, trie_node { { }, -1 });
+    for (size_t i = 0; i < this->_patterns.size(); ++i) {
+        int32_t node = 0;
+        for (char ch : this->_patterns[i]) {
+            uint16_t cls = this->_classes[static_cast<unsigned char>(ch)];
+            auto & children = trie[node].children;
+            auto it = std::find_if(children.begin(), children.end(), [cls](const std::pair<uint16_t, int32_t> & child) {
+                return child.first == cls;
+            });
+            if (it != children.end()) {
+                node = it->second;
+            } else {
+                int32_t child = static_cast<int32_t>(trie.size());
+                children.emplace_back(cls, child);
+                trie.push_back(trie_node { { }, -1 });
+                node = child;
+            }
+        }
+        // a duplicate keeps the first index
+        if (trie[node].pattern < 0) trie[node].pattern = static_cast<int32_t>(i);
+    }
+
+    // place states breadth first; each gets the lowest base whose target slots are all free
+    this->_slots.assign(this->_class_count, _slot { 0, -1, 0, -1 });
+
+    // free[i] == i for a free slot; a used one leads on towards the first free slot after it
+    // (union-find with path halving), so the search steps over runs of used slots at once
+    std::vector<size_t> free(this->_class_count);
+    for (size_t i = 0; i < free.size(); ++i) free[i] = i;
+    free[0] = 1;
+    auto first_free = [&free](size_t i) {
+        while (i < free.size() && free[i] != i) {
+            if (free[i] < free.size()) free[i] = free[free[i]];
+            i = free[i];
+        }
+        return i;
+    };
+
+    std::vector<int32_t> order(1, 0);
+    std::vector<int32_t> slot_of(trie.size(), 0);
+
+    // a state with several children rarely fits the holes left behind, so once a
+    // search has had to skip many, later ones start from where it succeeded;
+    // single children still fill the holes
+    size_t dense_until = 0;
+
+    for (size_t next = 0; next < order.size(); ++next) {
+        int32_t node = order[next];
+        auto & children = trie[node].children;
+        if (children.empty()) continue;
+        std::sort(children.begin(), children.end());
+
+        // try each free slot for the first child, and check the rest fit around it
+        size_t base = 0;
+        size_t from = children.size() > 1 ? std::max<size_t>(dense_until, children[0].first) : children[0].first;
+        size_t skipped = 0;
+        for (size_t slot = first_free(from); ; slot = first_free(slot + 1), ++skipped) {
+            base = slot - children[0].first;
+            bool fits = true;
+            for (size_t k = 1; k < children.size(); ++k) {
+                size_t target = base + children[k].first;
+                if (target < free.size() && free[target] != target) {
+                    fits = false;
+                    break;
+                }
+            }
+            if (fits) break;
+        }
+        if (skipped > 16) dense_until = base + children[0].first;
+
+        // keep every base + class inside the array, so lookups need no bounds check
+        if (base + this->_class_count > this->_slots.size()) {
+            size_t old_size = free.size();
+            this->_slots.resize(base + this->_class_count, _slot { 0, -1, 0, -1 });
+            free.resize(base + this->_class_count);
+            for (size_t i = old_size; i < free.size(); ++i) free[i] = i;
+        }
+
+        int32_t state = slot_of[node];
+        this->_slots[state].base = static_cast<int32_t>(base);
+        for (const auto & child : children) {
+            size_t target = base + child.first;
+            free[target] = target + 1;
+            this->_slots[target].check = state;
+            slot_of[child.second] = static_cast<int32_t>(target);
+            order.push_back(child.second);
+        }
+    }
+
+    // failure links and matches, parents before children so every link target is done
+    this->_slots[0].match = trie[0].pattern;
+    for (int32_t node : order) {
+        int32_t state = slot_of[node];
+        for (const auto & child : trie[node].children) {
+            int32_t target = slot_of[child.second];
+            int32_t fail = 0;
+            if (node != 0) {
+                for (int32_t f = this->_slots[state].fail; ; f = this->_slots[f].fail) {
+                    int32_t next = this->_next(f, child.first);
+                    if (next >= 0) {
+                        fail = next;
+                        break;
+                    }
+                    if (f == 0) break;
+                }
+            }
+            this->_slots[target].fail = fail;
+            this->_slots[target].match = trie[child.second].pattern >= 0 ? trie[child.second].pattern : this->_slots[fail].match;
+        }
+    }
+
+    this->_slots.shrink_to_fit();
+    this->_states = trie.size();
+
+    // expand to a dense table if it fits; a missing transition takes the failure link's, whose row is already done
+    this->_table.clear();
+    size_t width = this->_class_count;
+    if (this->_slots.size() * width > TABLE_LIMIT) return;
+    this->_table.assign(this->_slots.size() * width, 0);
+    for (int32_t node : order) {
+        int32_t state = slot_of[node];
+        uint32_t * row = &this->_table[static_cast<size_t>(state) * width];
+        const uint32_t * fallback = &this->_table[static_cast<size_t>(this->_slots[state].fail) * width];
+        for (size_t cls = 1; cls < width; ++cls) {
+            int32_t next = this->_next(state, static_cast<uint16_t>(cls));
+            if (next < 0) {
+                row[cls] = node == 0 ? 0 : fallback[cls];
+                continue;
+            }
+            row[cls] = static_cast<uint32_t>(static_cast<size_t>(next) * width);
+            if (this->_slots[next].match >= 0) row[cls] |= MATCH;
+        }
+    }
+
+}
+
+int aho_corasick::find(std::string_view text) const {
+
+    if (!this->_table.empty()) {
+        const uint32_t * table = this->_table.data();
+        uint32_t offset = 0;
+        for (char ch : text) {
+            offset = table[offset + this->_classes[static_cast<unsigned char>(ch)]];
+            if (offset & MATCH) return this->_slots[(offset & ~MATCH) / this->_class_count].match;
+        }
+        return -1;
+    }
+
+    int32_t state = 0;
+
+    for (char ch : text) {
+        uint16_t cls = this->_classes[static_cast<unsigned char>(ch)];
+
+        // a byte in no pattern cannot continue any match
+        if (cls == 0) {
+            state = 0;
+            continue;
+        }
+
+        for (;;) {
+            int32_t next = this->_next(state, cls);
+            if (next >= 0) {
+                state = next;
+                break;
+            }
+            if (state == 0) break;
+            state = this->_slots[state].fail;
+        }
+
+        if (this->_slots[state].match >= 0) return this->_slots[state].match;
+    }
+
+    return -1;
+
+}
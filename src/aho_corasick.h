@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * ## Aho-Corasick Automaton
+ * @brief Finds whether a text contains any of a set of patterns, in one pass
+ * over the text whatever the number of patterns.
+ *
+ * The patterns' trie is stored as a double array: a state's transition on
+ * byte class c is the slot base + c, valid when that slot's check names the
+ * state. Bytes are first mapped to classes, so the array is only as wide as
+ * the number of distinct bytes the patterns use, and bytes no pattern
+ * contains send the scan straight back to the root. A missing transition
+ * follows the failure link to the longest proper suffix that is still in the
+ * trie, which keeps the whole scan linear in the text.
+ *
+ * Each slot is 16 bytes (base, check, failure link, match), so a step of the
+ * scan touches one slot. When the automaton is small enough, build() also
+ * expands it into a dense table with a row per state and a column per class,
+ * failure links already followed, so a step is one load and no branch but
+ * the match test.
+ */
+class aho_corasick {
+    public:
+        // the largest dense table build() makes, in entries
+        static constexpr size_t TABLE_LIMIT = size_t(1) << 22;
+
+    private:
+        // set in a table entry when the state it leads to has a match
+        static constexpr uint32_t MATCH = 0x80000000u;
+
+        struct _slot {
+            int32_t base;
+            int32_t check;   // the state this slot is a transition from; -1 if free
+            int32_t fail;
+            int32_t match;   // a pattern ending here or at a suffix of here; -1 if none
+        };
+
+        std::vector<std::string> _patterns;
+        std::vector<_slot> _slots;
+        std::vector<uint32_t> _table;   // entries are the target's row offset, plus MATCH
+        uint16_t _classes[256];   // 0 for bytes that no pattern contains
+        size_t _class_count;
+        size_t _states;
+        bool _ignore_case;
+
+        int32_t _next(int32_t state, uint16_t cls) const {
+            int32_t target = this->_slots[state].base + cls;
+            return this->_slots[target].check == state ? target : -1;
+        }
+
+    public:
+        /**
+            @brief Creates an empty automaton.
+
+            @param ignore_case match ASCII letters regardless of case.
+        **/
+        explicit aho_corasick(bool ignore_case = false);
+
+        /**
+            @brief Adds a pattern; takes effect at the next build(). Empty patterns are ignored.
+        **/
+        void insert(std::string_view pattern) {
+            if (!pattern.empty()) this->_patterns.emplace_back(pattern);
+        }
+
+        /**
+            @brief Builds the automaton from every pattern inserted so far.
+        **/
+        void build();
+
+        /**
+            @brief Returns the index of the first pattern to end in text, or -1 if text contains none.
+        **/
+        int find(std::string_view text) const;
+
+        bool contains(std::string_view text) const { return this->find(text) >= 0; }
+
+        /**
+            @brief Returns pattern index as inserted, e.g. to report what find() matched.
+        **/
+        const std::string & pattern(size_t index) const { return this->_patterns[index]; }
+
+        size_t size() const noexcept { return this->_patterns.size(); }
+
+        size_t state_count() const noexcept { return this->_states; }
+
+        size_t memory_usage() const noexcept {
+            return this->_slots.capacity() * sizeof(_slot) + this->_table.capacity() * sizeof(uint32_t);
+        }
+};
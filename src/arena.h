@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstddef>     // size_t
+#include <cstdint>     // uintptr_t
+#include <cstring>     // std::memcpy
+#include <string_view>
+#include <type_traits> // std::false_type, std::true_type
+#include <vector>
+
+/**
+ * ## Arena
+ * @brief A bump allocator over large blocks. Allocation is a pointer increment,
+ * individual frees are no-ops, and every block is released at once by release()
+ * or the destructor, so building and tearing down a big table costs a handful of
+ * system allocations instead of one per node and key.
+ */
+class arena {
+    private:
+        static constexpr size_t DEFAULT_BLOCK_SIZE = 1u << 20;
+
+        std::vector<char*> _blocks;
+        char * _cursor;
+        char * _end;
+        size_t _block_size;
+        size_t _bytes_used;
+        size_t _bytes_reserved;
+
+        void _grow(size_t bytes) {
+            size_t size = bytes > this->_block_size ? bytes : this->_block_size;
+            char * block = new char[size];
+            this->_blocks.push_back(block);
+            this->_bytes_reserved += size;
+            this->_cursor = block;
+            this->_end = block + size;
+        }
+
+    public:
+        explicit arena(size_t block_size = DEFAULT_BLOCK_SIZE)
+            : _blocks(), _cursor(nullptr), _end(nullptr), _block_size(block_size), _bytes_used(0), _bytes_reserved(0) {}
+
+        ~arena() { this->release(); }
+
+        arena(const arena &) = delete;
+        arena & operator=(const arena &) = delete;
+
+        /**
+            @brief Returns bytes of storage aligned to align (a power of two).
+        **/
+        void * allocate(size_t bytes, size_t align) {
+
+            // round the cursor up to the alignment, starting a new block if it does not fit
+            uintptr_t p = (reinterpret_cast<uintptr_t>(this->_cursor) + align - 1) & ~(uintptr_t)(align - 1);
+            if (this->_cursor == nullptr || p + bytes > reinterpret_cast<uintptr_t>(this->_end)) {
+                this->_grow(bytes + align);
+                p = (reinterpret_cast<uintptr_t>(this->_cursor) + align - 1) & ~(uintptr_t)(align - 1);
+            }
+
+            this->_cursor = reinterpret_cast<char*>(p + bytes);
+            this->_bytes_used += bytes;
+            return reinterpret_cast<void*>(p);
+
+        }
+
+        /**
+            @brief Copies str into the arena and returns a view of the copy, valid until release().
+        **/
+        std::string_view store(std::string_view str) {
+            char * bytes = static_cast<char*>(this->allocate(str.size(), 1));
+            if (!str.empty()) std::memcpy(bytes, str.data(), str.size());
+            return std::string_view(bytes, str.size());
+        }
+
+        /**
+            @brief Frees every block. Everything allocated from the arena becomes invalid.
+        **/
+        void release() noexcept {
+            for (char * block : this->_blocks) delete[] block;
+            this->_blocks.clear();
+            this->_cursor = nullptr;
+            this->_end = nullptr;
+            this->_bytes_used = 0;
+            this->_bytes_reserved = 0;
+        }
+
+        size_t bytes_used() const noexcept { return this->_bytes_used; }
+
+        size_t bytes_reserved() const noexcept { return this->_bytes_reserved; }
+};
+
+/**
+ * ## Arena Allocator
+ * @brief A standard allocator that carves storage out of an arena. deallocate()
+ * is a no-op; memory comes back when the arena is released.
+ */
+template <typename T>
+class arena_allocator {
+    private:
+        template <typename U> friend class arena_allocator;
+
+        arena * _arena;
+
+    public:
+        using value_type = T;
+
+        explicit arena_allocator(arena * a) noexcept : _arena(a) {}
+
+        template <typename U>
+        arena_allocator(const arena_allocator<U> & other) noexcept : _arena(other._arena) {}
+
+        T * allocate(size_t n) { return static_cast<T*>(this->_arena->allocate(n * sizeof(T), alignof(T))); }
+
+        void deallocate(T *, size_t) noexcept {}
+
+        arena * get_arena() const noexcept { return this->_arena; }
+
+        template <typename U>
+        bool operator==(const arena_allocator<U> & other) const noexcept { return this->_arena == other._arena; }
+
+        template <typename U>
+        bool operator!=(const arena_allocator<U> & other) const noexcept { return this->_arena != other._arena; }
+};
+
+/*
+    True for allocators whose deallocate() does nothing, letting containers skip
+    walking their elements on clear/destruction when the elements are trivially
+    destructible.
+*/
+template <typename Alloc>
+struct is_monotonic_allocator : std::false_type {};
+
+template <typename T>
+struct is_monotonic_allocator<arena_allocator<T>> : std::true_type {};
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "embedded_block_list.h"
+#include "ipv4.h"
+#include "ipv6.h"
+#include "perfect_hash.h"
+#include "url.h"
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/**
+ * ## Embedded Filter
+ * @brief Answers the same questions as malicious_url_filter from a block list
+ * compiled into the binary.
+ *
+ * The tables live in embedded_block_list.h, which tools/generate_perfect_hash.cpp
+ * writes from a block list. They are constexpr arrays in read-only data, so
+ * there is nothing to load, allocate or hash at start-up, and every lookup is
+ * a single probe of a minimal perfect hash followed by one key compare.
+ * IPv6 CIDR entries are few enough in practice to be binary searched instead,
+ * one length at a time.
+ */
+class embedded_filter {
+    private:
+        static bool _has_prefix(uint32_t network, uint8_t length) {
+            if (EMBEDDED_PREFIXES.slot_count == 0) return false;
+            uint64_t key = perfect_hash_prefix(network, length);
+            return EMBEDDED_PREFIX_SLOTS[EMBEDDED_PREFIXES.find(key)] == key;
+        }
+
+        static bool _has_prefix6(const ipv6_address & network, uint8_t length) {
+            if (length > 128) return false;
+            uint32_t first = EMBEDDED_PREFIX6_STARTS[length], last = EMBEDDED_PREFIX6_STARTS[length + 1];
+            while (first < last) {
+                uint32_t middle = first + (last - first) / 2;
+                ipv6_address listed { EMBEDDED_PREFIX6_WORDS[2 * middle], EMBEDDED_PREFIX6_WORDS[2 * middle + 1] };
+                if (listed == network) return true;
+                if (listed < network) first = middle + 1;
+                else last = middle;
+            }
+            return false;
+        }
+
+        static bool _has_key(std::string_view entry) {
+            if (EMBEDDED_KEYS.slot_count == 0) return false;
+            uint32_t slot = EMBEDDED_KEYS.find(entry);
+            uint32_t begin = EMBEDDED_KEY_OFFSETS[slot];
+            return entry == std::string_view(EMBEDDED_KEY_BYTES + begin, EMBEDDED_KEY_OFFSETS[slot + 1] - begin);
+        }
+
+    public:
+        /**
+            @brief Determines if IP is an entry of the embedded list. CIDR text is compared as a prefix.
+        **/
+        bool is_Malicious_URL(std::string_view IP) const {
+            ipv4_prefix prefix;
+            if (parse_ipv4_cidr(IP, prefix)) return _has_prefix(prefix.network, prefix.length);
+            ipv6_prefix prefix6;
+            if (parse_ipv6_cidr(IP, prefix6)) return _has_prefix6(prefix6.network, prefix6.length);
+            return _has_key(IP);
+        }
+
+        /**
+            @brief Determines if the host of url is a blocked domain or lies under one.
+            An IPv4 or bracketed IPv6 host is checked against the blocked ranges instead.
+        **/
+        bool is_Malicious_Domain(std::string_view url) const {
+            char buffer[URL_HOST_MAX];
+            std::string_view host;
+            if (!extract_url_host(url, buffer, host)) return false;
+
+            uint32_t address;
+            if (parse_ipv4(host, address)) return this->is_Malicious_IP(address);
+            ipv6_address address6;
+            if (host.front() == '[')
+                return parse_ipv6(host.substr(1, host.size() - 2), address6) && this->is_Malicious_IP(address6);
+
+            do {
+                if (_has_key(host)) return true;
+            } while (parent_domain(host));
+            return false;
+        }
+
+        /**
+            @brief Determines if IP falls inside any CIDR range of the embedded list.
+        **/
+        bool is_Malicious_IP(uint32_t IP) const {
+            // one probe per prefix length the list actually uses
+            for (uint64_t lengths = EMBEDDED_PREFIX_LENGTHS; lengths != 0; lengths &= lengths - 1) {
+                uint8_t length = static_cast<uint8_t>(__builtin_ctzll(lengths));
+                if (_has_prefix(IP & ipv4_mask(length), length)) return true;
+            }
+            return false;
+        }
+
+        bool is_Malicious_IP(const ipv6_address & IP) const {
+            for (size_t word = 0; word < 3; ++word) {
+                for (uint64_t lengths = EMBEDDED_PREFIX6_LENGTHS[word]; lengths != 0; lengths &= lengths - 1) {
+                    uint8_t length = static_cast<uint8_t>(word * 64 + static_cast<size_t>(__builtin_ctzll(lengths)));
+                    if (_has_prefix6(ipv6_mask(IP, length), length)) return true;
+                }
+            }
+            return false;
+        }
+
+        bool is_Malicious_IP(std::string_view IP) const {
+            uint32_t address;
+            if (parse_ipv4(IP, address)) return this->is_Malicious_IP(address);
+            ipv6_address address6;
+            return parse_ipv6(IP, address6) && this->is_Malicious_IP(address6);
+        }
+
+        size_t prefix_count() const { return EMBEDDED_PREFIXES.slot_count; }
+
+        size_t ipv6_prefix_count() const { return EMBEDDED_PREFIX6_STARTS[129]; }
+
+        size_t key_count() const { return EMBEDDED_KEYS.slot_count; }
+};
@@ -0,0 +1,128 @@
+#include "epoch.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+// the calling thread's slot and guard nesting depth
+struct epoch_thread_state {
+    epoch_domain::reader_slot * slot = nullptr;
+    unsigned depth = 0;
+
+    // hand the slot back when the thread exits
+    ~epoch_thread_state() { if (this->slot != nullptr) epoch_domain::global()._release(this->slot); }
+};
+
+static thread_local epoch_thread_state _thread_state;
+
+epoch_domain::epoch_domain() : _epoch(1), _readers(), _retired_lock(), _retired() {
+    for (reader_slot & slot : this->_readers) {
+        slot.epoch.store(IDLE, std::memory_order_relaxed);
+        slot.in_use.store(false, std::memory_order_relaxed);
+    }
+}
+
+epoch_domain & epoch_domain::global() {
+    static epoch_domain domain;
+    return domain;
+}
+
+epoch_domain::reader_slot * epoch_domain::_claim() {
+
+    // once per thread: take the first free slot
+    for (reader_slot & slot : this->_readers) {
+        bool expected = false;
+        if (!slot.in_use.load(std::memory_order_relaxed)
+            && slot.in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)) return &slot;
+    }
+
+    // slots are only freed by exiting threads, so waiting could hang this one forever
+    std::fprintf(stderr, "epoch_domain: more than %zu live reader threads; rebuild with a larger MALICIOUS_FILTER_MAX_READERS\n",
+                 MAX_READERS);
+    std::abort();
+
+}
+
+void epoch_domain::_release(reader_slot * slot) noexcept {
+    slot->epoch.store(IDLE, std::memory_order_release);
+    slot->in_use.store(false, std::memory_order_release);
+}
+
+uint64_t epoch_domain::_oldest_pinned() const noexcept {
+    uint64_t oldest = IDLE;
+    for (const reader_slot & slot : this->_readers) {
+        uint64_t e = slot.epoch.load(std::memory_order_acquire);
+        if (e < oldest) oldest = e;
+    }
+    return oldest;
+}
+
+epoch_domain::guard::guard() : _slot(nullptr), _outer(false) {
+
+    epoch_thread_state & state = _thread_state;
+    if (state.slot == nullptr) state.slot = epoch_domain::global()._claim();
+    this->_slot = state.slot;
+
+    // only the outermost guard publishes an epoch
+    this->_outer = state.depth++ == 0;
+    if (!this->_outer) return;
+
+    // publish the epoch before reading any shared pointer
+    this->_slot->epoch.store(epoch_domain::global()._epoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+}
+
+epoch_domain::guard::~guard() {
+    --_thread_state.depth;
+    if (this->_outer) this->_slot->epoch.store(IDLE, std::memory_order_release);
+}
+
+void epoch_domain::retire(void * object, void (*deleter)(void *)) {
+
+    // readers that pinned at or before this epoch may still hold object; later ones cannot
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint64_t epoch = this->_epoch.fetch_add(1, std::memory_order_acq_rel);
+
+    std::lock_guard<std::mutex> lock(this->_retired_lock);
+    this->_retired.push_back(retired { epoch, object, deleter });
+
+}
+
+size_t epoch_domain::reclaim() {
+
+    std::vector<retired> ready;
+    size_t waiting;
+
+    {
+        std::lock_guard<std::mutex> lock(this->_retired_lock);
+        uint64_t oldest = this->_oldest_pinned();
+
+        // split off everything retired before the oldest pinned reader arrived
+        size_t kept = 0;
+        for (retired & r : this->_retired) {
+            if (r.epoch < oldest) ready.push_back(r);
+            else this->_retired[kept++] = r;
+        }
+        this->_retired.resize(kept);
+        waiting = kept;
+    }
+
+    // run the deleters outside the lock
+    for (retired & r : ready) r.deleter(r.object);
+    return waiting;
+
+}
+
+void epoch_domain::synchronize() {
+    while (this->reclaim() != 0) std::this_thread::yield();
+}
+
+void epoch_domain::wait_for_readers() {
+
+    // as in retire(): readers pinned at or before this epoch may still see what was unpublished
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint64_t epoch = this->_epoch.fetch_add(1, std::memory_order_acq_rel);
+    while (this->_oldest_pinned() <= epoch) std::this_thread::yield();
+
+}
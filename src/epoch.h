@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#ifndef MALICIOUS_FILTER_MAX_READERS
+// threads that may hold a reader slot at once; each slot takes a cache line
+#define MALICIOUS_FILTER_MAX_READERS 256
+#endif
+
+/**
+ * ## Epoch Domain
+ * @brief Epoch-based reclamation for read-mostly shared objects.
+ *
+ * Readers pin the current epoch for the duration of a read; pinning and
+ * unpinning are a couple of plain atomic stores, so readers never wait. A
+ * writer that unpublishes an object retires it with the epoch at that moment,
+ * and the object is freed once every pinned reader has moved past that epoch,
+ * i.e. once nobody can still hold a pointer to it.
+ *
+ * There is one process-wide domain (see global()), so per-thread reader slots
+ * never outlive the domain they point into.
+ *
+ * A thread takes a slot on its first guard and keeps it until it exits, so at
+ * most MAX_READERS threads (MALICIOUS_FILTER_MAX_READERS, 256 by default) may
+ * have read through the domain and still be alive. The next thread to open a
+ * guard aborts the process with a message rather than wait for a slot that
+ * may never come free.
+ */
+class epoch_domain {
+    public:
+        static constexpr size_t MAX_READERS = MALICIOUS_FILTER_MAX_READERS;
+
+    private:
+        static constexpr uint64_t IDLE = UINT64_MAX;
+
+        struct alignas(64) reader_slot {
+            std::atomic<uint64_t> epoch;
+            std::atomic<bool> in_use;
+        };
+
+        struct retired {
+            uint64_t epoch;
+            void * object;
+            void (*deleter)(void *);
+        };
+
+        std::atomic<uint64_t> _epoch;
+        reader_slot _readers[MAX_READERS];
+
+        std::mutex _retired_lock;
+        std::vector<retired> _retired;
+
+        epoch_domain();
+
+        reader_slot * _claim();
+        void _release(reader_slot * slot) noexcept;
+        uint64_t _oldest_pinned() const noexcept;
+
+        friend struct epoch_thread_state;
+
+    public:
+        epoch_domain(const epoch_domain &) = delete;
+        epoch_domain & operator=(const epoch_domain &) = delete;
+
+        static epoch_domain & global();
+
+        /**
+         * @brief Keeps retired objects alive while in scope. Guards nest.
+         */
+        class guard {
+            private:
+                reader_slot * _slot;
+                bool _outer;
+
+            public:
+                guard();
+                ~guard();
+                guard(const guard &) = delete;
+                guard & operator=(const guard &) = delete;
+        };
+
+        /**
+            @brief Schedules object for deletion once no reader pinned before now can see it.
+            Call after the object has been unpublished.
+        **/
+        template <typename T>
+        void retire(T * object) {
+            this->retire(static_cast<void*>(object), [](void * p) { delete static_cast<T*>(p); });
+        }
+
+        void retire(void * object, void (*deleter)(void *));
+
+        /**
+            @brief Frees every retired object that no reader can still see.
+
+            @return the number of objects still waiting.
+        **/
+        size_t reclaim();
+
+        /**
+            @brief Blocks until every object retired so far has been freed.
+        **/
+        void synchronize();
+
+        /**
+            @brief Blocks until every reader pinned before now has unpinned. An object
+            unpublished before the call can then be changed or reused instead of retired.
+        **/
+        void wait_for_readers();
+};
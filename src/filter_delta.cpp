@@ -0,0 +1,69 @@
+#include "filter_delta.h"
+
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+#include <utility>
+
+bool parse_filter_delta(std::string_view text, filter_delta & out) {
+
+    filter_delta delta;
+    bool numbered = false;
+
+    // the last line for each entry: true to add, false to remove
+    std::vector<std::pair<std::string_view, bool>> changes;
+    std::unordered_map<std::string_view, size_t> latest;
+
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t newline = text.find('\n', start);
+        if (newline == std::string_view::npos) newline = text.size();
+        std::string_view line = text.substr(start, newline - start);
+        start = newline + 1;
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (line.empty()) continue;
+
+        if (line.front() == '#') {
+            // "# seq N" numbers the delta; any other comment is skipped
+            std::string_view rest = line.substr(1);
+            while (!rest.empty() && rest.front() == ' ') rest.remove_prefix(1);
+            if (rest.substr(0, 4) != "seq ") continue;
+            rest.remove_prefix(4);
+            if (numbered || rest.empty() || rest.size() > 19) return false;
+            for (char c : rest) {
+                if (c < '0' || c > '9') return false;
+                delta.sequence = delta.sequence * 10 + static_cast<uint64_t>(c - '0');
+            }
+            numbered = true;
+            continue;
+        }
+
+        if (line.front() != '+' && line.front() != '-') return false;
+        bool add = line.front() == '+';
+        std::string_view entry = line.substr(1);
+        while (!entry.empty() && (entry.front() == ' ' || entry.front() == '\t')) entry.remove_prefix(1);
+        if (entry.empty()) return false;
+
+        auto found = latest.find(entry);
+        if (found != latest.end()) {
+            changes[found->second].second = add;
+        } else {
+            latest.emplace(entry, changes.size());
+            changes.emplace_back(entry, add);
+        }
+    }
+    if (!numbered) return false;
+
+    for (const std::pair<std::string_view, bool> & change : changes)
+        (change.second ? delta.added : delta.removed).emplace_back(change.first);
+    out = std::move(delta);
+    return true;
+
+}
+
+bool read_filter_delta(std::string const & path, filter_delta & out) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return !file.bad() && parse_filter_delta(text, out);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * ## Filter Delta
+ * @brief One batch of changes to a block list, as a feed publishes them between full lists.
+ *
+ * The text form is a sequence number, then one change per line:
+ *
+ *     # seq 42
+ *     + evil.example
+ *     - 203.0.113.0/24
+ *
+ * "+" adds an entry and "-" removes one. Entries are written exactly as in a
+ * block list. Blank lines and other lines starting with '#' are skipped, and
+ * a trailing '\r' is dropped. When one entry appears more than once, its last
+ * line wins, so added and removed never share an entry.
+ */
+struct filter_delta {
+    uint64_t sequence = 0;
+    std::vector<std::string> added {};
+    std::vector<std::string> removed {};
+};
+
+/**
+    @brief Parses the text form of a delta.
+
+    @param text the whole delta.
+    @param out receives the delta on success.
+    @return false if the "# seq" line is missing or any line is neither a change, a comment nor blank.
+**/
+bool parse_filter_delta(std::string_view text, filter_delta & out);
+
+/**
+    @brief Reads and parses the delta file at path.
+
+    @return false if the file cannot be read or does not parse.
+**/
+bool read_filter_delta(std::string const & path, filter_delta & out);
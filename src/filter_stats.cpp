@@ -0,0 +1,68 @@
+#include "filter_stats.h"
+
+#include <sstream>
+
+double filter_stats::latency_quantile(double q) const {
+    if (this->latency_samples == 0) return 0.0;
+
+    // the first bin whose running total reaches q of the samples
+    uint64_t target = static_cast<uint64_t>(q * static_cast<double>(this->latency_samples));
+    uint64_t seen = 0;
+    for (size_t b = 0; b < LATENCY_BINS; ++b) {
+        seen += this->latency[b];
+        if (seen > target || b == LATENCY_BINS - 1) return static_cast<double>(uint64_t(1) << (b + 1));
+    }
+    return 0.0;
+}
+
+std::string filter_stats::to_text() const {
+    std::ostringstream os;
+
+    if (this->counted) {
+        os << "lookups:         " << this->lookups << " (" << this->hits << " hits, " << this->misses << " misses)\n";
+        if (this->latency_samples > 0) {
+            os << "latency:         p50 < " << this->latency_quantile(0.5) << " ns, p99 < " << this->latency_quantile(0.99)
+               << " ns, p99.9 < " << this->latency_quantile(0.999) << " ns (" << this->latency_samples << " sampled)\n";
+        }
+    } else {
+        os << "lookups:         not counted (build with -DMALICIOUS_FILTER_STATS)\n";
+    }
+
+    os << "map entries:     " << this->entries << " in " << this->buckets << " buckets, load factor " << this->load_factor << "\n";
+    os << "probe length:    " << this->average_probe << " average, " << this->max_probe << " max\n";
+    os << "occupancy:      ";
+    for (size_t n = 0; n < OCCUPANCY_BINS; ++n) {
+        os << " " << n << (n == OCCUPANCY_BINS - 1 ? "+" : "") << ":" << this->occupancy[n];
+    }
+    os << "\n";
+
+    os << "memory:          " << this->memory_bytes() << " bytes (map " << this->map_bytes << ", CIDR " << this->prefix_bytes
+       << ", IPv6 " << this->ipv6_bytes << ", prefilter " << this->prefilter_bytes << ", patterns " << this->pattern_bytes << ")\n";
+    os << "load time:       " << this->load_seconds * 1e3 << " ms\n";
+    if (this->cached) {
+        uint64_t total = this->cache_hits + this->cache_misses;
+        os << "result cache:    " << this->cache_hits << " hits, " << this->cache_misses << " misses ("
+           << (total == 0 ? 0.0 : 100.0 * static_cast<double>(this->cache_hits) / static_cast<double>(total)) << "% hit rate)\n";
+    }
+    return os.str();
+}
+
+std::string filter_stats::to_json() const {
+    std::ostringstream os;
+
+    os << "{\"counted\":" << (this->counted ? "true" : "false")
+       << ",\"lookups\":" << this->lookups << ",\"hits\":" << this->hits << ",\"misses\":" << this->misses
+       << ",\"latency_samples\":" << this->latency_samples << ",\"latency_ns_log2\":[";
+    for (size_t b = 0; b < LATENCY_BINS; ++b) os << (b == 0 ? "" : ",") << this->latency[b];
+
+    os << "],\"entries\":" << this->entries << ",\"buckets\":" << this->buckets << ",\"load_factor\":" << this->load_factor
+       << ",\"average_probe\":" << this->average_probe << ",\"max_probe\":" << this->max_probe << ",\"occupancy\":[";
+    for (size_t n = 0; n < OCCUPANCY_BINS; ++n) os << (n == 0 ? "" : ",") << this->occupancy[n];
+
+    os << "],\"memory\":{\"total\":" << this->memory_bytes() << ",\"map\":" << this->map_bytes << ",\"cidr\":" << this->prefix_bytes
+       << ",\"ipv6\":" << this->ipv6_bytes << ",\"prefilter\":" << this->prefilter_bytes << ",\"patterns\":" << this->pattern_bytes
+       << "},\"load_seconds\":" << this->load_seconds;
+    if (this->cached) os << ",\"cache\":{\"hits\":" << this->cache_hits << ",\"misses\":" << this->cache_misses << "}";
+    os << "}";
+    return os.str();
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/**
+ * ## Filter Statistics
+ * @brief A point-in-time view of a filter: what its lookups have done, how its
+ * hash map is laid out, and what it costs in memory and load time.
+ *
+ * The lookup counters and latency samples are only gathered in builds with
+ * -DMALICIOUS_FILTER_STATS (counted is false otherwise, and they read zero).
+ * Everything else is computed from the filter's structure when asked for.
+ */
+struct filter_stats {
+    // buckets holding 0 .. OCCUPANCY_BINS - 2 entries, then the rest
+    static constexpr size_t OCCUPANCY_BINS = 9;
+    // bin i counts lookups that took [2^i, 2^(i+1)) ns; the last bin is open-ended
+    static constexpr size_t LATENCY_BINS = 24;
+
+    bool counted = false;
+    uint64_t lookups = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t latency_samples = 0;
+    uint64_t latency[LATENCY_BINS] = { };
+
+    // the string map; probe lengths are nodes compared (chained) or groups scanned (flat)
+    size_t entries = 0;
+    size_t buckets = 0;
+    double load_factor = 0.0;
+    double average_probe = 0.0;
+    size_t max_probe = 0;
+    size_t occupancy[OCCUPANCY_BINS] = { };
+
+    size_t map_bytes = 0;
+    size_t prefix_bytes = 0;
+    size_t ipv6_bytes = 0;
+    size_t prefilter_bytes = 0;
+    size_t pattern_bytes = 0;
+    double load_seconds = 0.0;
+
+    // answers served by a cached_filter in front of the filter, and those it passed through
+    bool cached = false;
+    uint64_t cache_hits = 0;
+    uint64_t cache_misses = 0;
+
+    size_t memory_bytes() const { return map_bytes + prefix_bytes + ipv6_bytes + prefilter_bytes + pattern_bytes; }
+
+    /**
+        @brief Returns the latency below which fraction q of the sampled lookups fell,
+        as the upper edge of its bin in nanoseconds, or 0 if nothing was sampled.
+    **/
+    double latency_quantile(double q) const;
+
+    /**
+        @brief Fills in the map fields from any map with for_each_bucket_size and for_each_probe_length.
+    **/
+    template <typename Map>
+    void add_map(const Map & map) {
+        this->entries = map.size();
+        this->buckets = map.bucket_count();
+        this->load_factor = map.load_factor();
+        map.for_each_bucket_size([this](size_t n) {
+            ++this->occupancy[n < OCCUPANCY_BINS - 1 ? n : OCCUPANCY_BINS - 1];
+        });
+        size_t total = 0;
+        map.for_each_probe_length([this, &total](size_t n) {
+            total += n;
+            if (n > this->max_probe) this->max_probe = n;
+        });
+        this->average_probe = this->entries == 0 ? 0.0 : static_cast<double>(total) / static_cast<double>(this->entries);
+    }
+
+    /**
+        @brief Returns the statistics as aligned "name: value" lines.
+    **/
+    std::string to_text() const;
+
+    /**
+        @brief Returns the statistics as one JSON object.
+    **/
+    std::string to_json() const;
+};
+
+/*
+    A small number per thread, handed out in the order threads first ask, so
+    per-thread counters can each keep to their own cache line. Wraps at shards.
+*/
+inline size_t counter_shard(size_t shards) {
+    static std::atomic<size_t> next { 0 };
+    static thread_local size_t index = next.fetch_add(1, std::memory_order_relaxed);
+    return index % shards;
+}
+
+#ifndef MALICIOUS_FILTER_STATS_SAMPLE
+// one lookup in this many (a power of two) is timed; 0 turns latency sampling off
+#define MALICIOUS_FILTER_STATS_SAMPLE 1024
+#endif
+
+#ifdef MALICIOUS_FILTER_STATS
+
+/**
+ * ## Lookup Counters
+ * @brief Per-thread lookup, hit and sampled latency counts, summed when read.
+ *
+ * Each thread writes only its own cache line, with relaxed loads and stores
+ * rather than read-modify-write instructions, so counting costs a few plain
+ * adds per lookup. Threads past the first SHARDS share lines and may then
+ * lose the odd increment to a race; the totals stay approximately right.
+ */
+class lookup_counters {
+    private:
+        static constexpr size_t SHARDS = 64;
+
+        struct alignas(64) shard {
+            std::atomic<uint64_t> lookups;
+            std::atomic<uint64_t> hits;
+            std::atomic<uint64_t> latency[filter_stats::LATENCY_BINS];
+        };
+
+        std::unique_ptr<shard[]> _shards;
+
+        static void _bump(std::atomic<uint64_t> & counter, uint64_t n = 1) {
+            counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+        static size_t _latency_bin(uint64_t ns) {
+            size_t bin = ns == 0 ? 0 : static_cast<size_t>(63 - __builtin_clzll(ns));
+            return bin < filter_stats::LATENCY_BINS ? bin : filter_stats::LATENCY_BINS - 1;
+        }
+
+    public:
+        lookup_counters() : _shards(new shard[SHARDS]) {
+            for (size_t s = 0; s < SHARDS; ++s) {
+                this->_shards[s].lookups.store(0, std::memory_order_relaxed);
+                this->_shards[s].hits.store(0, std::memory_order_relaxed);
+                for (std::atomic<uint64_t> & bin : this->_shards[s].latency) bin.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        /**
+            @brief Runs lookup() and counts its result; every MALICIOUS_FILTER_STATS_SAMPLE-th call on a thread is also timed.
+        **/
+        template <typename F>
+        bool count(F && lookup) const {
+            shard & mine = this->_shards[counter_shard(SHARDS)];
+            uint64_t n = mine.lookups.load(std::memory_order_relaxed);
+            mine.lookups.store(n + 1, std::memory_order_relaxed);
+
+            bool hit;
+            if (MALICIOUS_FILTER_STATS_SAMPLE != 0 && (n & (MALICIOUS_FILTER_STATS_SAMPLE - 1)) == 0) {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                hit = lookup();
+                auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+                _bump(mine.latency[_latency_bin(static_cast<uint64_t>(ns))]);
+            } else {
+                hit = lookup();
+            }
+            if (hit) _bump(mine.hits);
+            return hit;
+        }
+
+        /**
+            @brief Counts a batch of count lookups of which hits matched, without timing them.
+        **/
+        void count_batch(size_t count, size_t hits) const {
+            shard & mine = this->_shards[counter_shard(SHARDS)];
+            _bump(mine.lookups, count);
+            _bump(mine.hits, hits);
+        }
+
+        /**
+            @brief Adds every thread's counts into stats.
+        **/
+        void read(filter_stats & stats) const {
+            stats.counted = true;
+            for (size_t s = 0; s < SHARDS; ++s) {
+                stats.lookups += this->_shards[s].lookups.load(std::memory_order_relaxed);
+                stats.hits += this->_shards[s].hits.load(std::memory_order_relaxed);
+                for (size_t b = 0; b < filter_stats::LATENCY_BINS; ++b) {
+                    uint64_t n = this->_shards[s].latency[b].load(std::memory_order_relaxed);
+                    stats.latency[b] += n;
+                    stats.latency_samples += n;
+                }
+            }
+            stats.misses = stats.lookups - stats.hits;
+        }
+};
+
+#else
+
+// without MALICIOUS_FILTER_STATS every call inlines to the lookup itself
+class lookup_counters {
+    public:
+        template <typename F>
+        bool count(F && lookup) const { return lookup(); }
+
+        void count_batch(size_t, size_t) const { }
+
+        void read(filter_stats &) const { }
+};
+
+#endif
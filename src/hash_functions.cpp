@@ -1,6 +1,12 @@
 #include "hash_functions.h"
 
-size_t polynomial_rolling_hash::operator() (std::string const & str) const {
+#include <cstring>  // memcpy
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+size_t polynomial_rolling_hash::operator() (std::string_view str) const {
 
     // define variables
     size_t hash = 0;
@@ -8,7 +14,7 @@ size_t polynomial_rolling_hash::operator() (std::string const & str) const {
 
     // for each character, peform the function
     for (size_t i = 0; i < str.size(); ++i) {
-        int each = static_cast<int>(str.at(i));
+        int each = static_cast<int>(str[i]);
         hash += each * p;
         p = (p * 19) % 3298534883309ul;
     }
@@ -17,7 +23,7 @@ size_t polynomial_rolling_hash::operator() (std::string const & str) const {
 
 }
 
-size_t fnv1a_hash::operator() (std::string const & str) const {
+size_t fnv1a_hash::operator() (std::string_view str) const {
 
     // define variables
     const size_t prime = 0x00000100000001B3;
@@ -26,10 +32,144 @@ size_t fnv1a_hash::operator() (std::string const & str) const {
 
     // for each character, perform the function
     for (size_t i = 0; i < str.size(); ++i) {
-        int each = static_cast<int>(str.at(i));
+        int each = static_cast<int>(str[i]);
         hash = (hash ^ each) * prime;
     }
 
     return hash;
 
 }
+
+/* unaligned native-order loads; hash values only need to agree within one machine type */
+static inline uint64_t _read64(const char * p) { uint64_t v; std::memcpy(&v, p, 8); return v; }
+static inline uint64_t _read32(const char * p) { uint32_t v; std::memcpy(&v, p, 4); return v; }
+
+/* one to three bytes packed into a word: first, middle and last */
+static inline uint64_t _read_small(const char * p, size_t n) {
+    return (static_cast<uint64_t>(static_cast<unsigned char>(p[0])) << 16)
+         | (static_cast<uint64_t>(static_cast<unsigned char>(p[n >> 1])) << 8)
+         | static_cast<unsigned char>(p[n - 1]);
+}
+
+size_t fnv1a_wide_hash::operator() (std::string_view str) const {
+
+    const uint64_t prime = 0x00000100000001B3;
+    const uint64_t basis = 0xCBF29CE484222325;
+    uint64_t hash = basis ^ str.size();
+    const char * p = str.data();
+    size_t n = str.size();
+
+    // eight bytes per multiply; the shift keeps high input bits from only ever moving upward
+    for (; n >= 8; p += 8, n -= 8) {
+        hash = (hash ^ _read64(p)) * prime;
+        hash ^= hash >> 32;
+    }
+
+    // the last zero to seven bytes as one word
+    uint64_t tail = 0;
+    if (n >= 4) tail = (_read32(p) << 32) | _read32(p + n - 4);
+    else if (n > 0) tail = _read_small(p, n);
+
+    return static_cast<size_t>(hash_mix(hash ^ tail, prime ^ UINT64_C(0xe7037ed1a0b428db)));
+
+}
+
+// wyhash's default secret
+static const uint64_t _wy_secret[4] = {
+    UINT64_C(0xa0761d6478bd642f), UINT64_C(0xe7037ed1a0b428db),
+    UINT64_C(0x8ebc6af09c88c6e3), UINT64_C(0x589965cc75374cc3)
+};
+
+size_t wy_hash::operator() (std::string_view str) const {
+
+    const char * p = str.data();
+    size_t n = str.size();
+    uint64_t seed = hash_mix(_wy_secret[0], _wy_secret[1]);
+    uint64_t a, b;
+
+    if (n <= 16) {
+        // short keys (every IP entry) are read as two possibly overlapping halves
+        if (n >= 4) {
+            size_t step = (n >> 3) << 2;
+            a = (_read32(p) << 32) | _read32(p + step);
+            b = (_read32(p + n - 4) << 32) | _read32(p + n - 4 - step);
+        } else if (n > 0) {
+            a = _read_small(p, n);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        // sixteen bytes per mix, then the last sixteen (overlapping) bytes
+        size_t i = n;
+        for (; i > 16; i -= 16, p += 16) seed = hash_mix(_read64(p) ^ _wy_secret[1], _read64(p + 8) ^ seed);
+        a = _read64(p + i - 16);
+        b = _read64(p + i - 8);
+    }
+
+    return static_cast<size_t>(hash_mix(_wy_secret[1] ^ n, hash_mix(a ^ _wy_secret[1], b ^ seed)));
+
+}
+
+/* CRC-32C (Castagnoli, reflected) byte table, the same polynomial the SSE4.2 instruction uses */
+struct _crc32c_table {
+    uint32_t entries[256];
+
+    _crc32c_table() : entries() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1)));
+            this->entries[i] = crc;
+        }
+    }
+};
+
+/*
+    The CRC runs over whole words: the key's full eight-byte words, then its last
+    one to seven bytes packed into one more word with two overlapping reads. The
+    length is mixed in afterwards, so the packing cannot make two keys collide.
+*/
+static inline uint64_t _tail_word(const char * p, size_t n) {
+    return n >= 4 ? (_read32(p) << 32) | _read32(p + n - 4) : _read_small(p, n);
+}
+
+static uint32_t _crc32c_portable(uint32_t crc, const char * p, size_t n) {
+
+    static const _crc32c_table table;
+    auto step = [&crc](uint64_t word) {
+        unsigned char bytes[8];
+        std::memcpy(bytes, &word, 8);
+        for (unsigned char byte : bytes) crc = table.entries[(crc ^ byte) & 0xff] ^ (crc >> 8);
+    };
+
+    for (; n >= 8; p += 8, n -= 8) step(_read64(p));
+    if (n > 0) step(_tail_word(p, n));
+    return crc;
+
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t _crc32c_sse42(uint32_t crc, const char * p, size_t n) {
+    uint64_t wide = crc;
+    for (; n >= 8; p += 8, n -= 8) wide = _mm_crc32_u64(wide, _read64(p));
+    if (n > 0) wide = _mm_crc32_u64(wide, _tail_word(p, n));
+    return static_cast<uint32_t>(wide);
+}
+
+static const bool _has_sse42 = __builtin_cpu_supports("sse4.2");
+#endif
+
+size_t crc32c_hash::operator() (std::string_view str) const {
+
+#if defined(__x86_64__)
+    uint32_t crc = _has_sse42 ? _crc32c_sse42(0xFFFFFFFFu, str.data(), str.size())
+                              : _crc32c_portable(0xFFFFFFFFu, str.data(), str.size());
+#else
+    uint32_t crc = _crc32c_portable(0xFFFFFFFFu, str.data(), str.size());
+#endif
+
+    // a CRC is only 32 bits and linear; spread it (and the length) over the whole word
+    return static_cast<size_t>(hash_mix(crc ^ (static_cast<uint64_t>(str.size()) << 32), _wy_secret[2]));
+
+}
@@ -0,0 +1,160 @@
+#include "ipv4.h"
+
+#include <algorithm>
+#include <cstring>  // memchr
+
+// the value of a digit character, or something above 9 for any other byte
+static inline uint32_t _digit(unsigned char c) { return static_cast<uint32_t>(c) - '0'; }
+
+/*
+    Parses "a.b.c.d" at the front of [p, end), returning the position just past
+    the last octet, or nullptr if it is malformed.
+
+    While three bytes remain, an octet is read without branching on its width:
+    all three bytes are classified at once and the width and value follow from
+    which of them are digits. Octet widths in real input are effectively random,
+    so this avoids a misprediction per octet; only an octet in the last two
+    bytes of the text takes the careful byte-by-byte path.
+*/
+static const unsigned char * _parse_address(const unsigned char * p, const unsigned char * end, uint32_t & out) {
+
+    uint32_t address = 0;
+
+    for (int part = 0; part < 4; ++part) {
+        if (part > 0) {
+            if (p == end || *p != '.') return nullptr;
+            ++p;
+        }
+
+        uint32_t octet;
+        if (end - p >= 3) {
+            uint32_t a = _digit(p[0]), b = _digit(p[1]), c = _digit(p[2]);
+            uint32_t two = b <= 9, three = two & (c <= 9);
+            octet = a;
+            octet = two ? octet * 10 + b : octet;
+            octet = three ? octet * 10 + c : octet;
+
+            // reject a missing digit, leading zeros, and values past 255
+            if ((a > 9) | (two & (a == 0)) | (octet > 255)) return nullptr;
+            p += 1 + two + three;
+        } else {
+            if (p == end || _digit(*p) > 9) return nullptr;
+            octet = _digit(*p++);
+            if (p < end && _digit(*p) <= 9) {
+                if (octet == 0) return nullptr;
+                octet = octet * 10 + _digit(*p++);
+            }
+        }
+
+        address = (address << 8) | octet;
+    }
+
+    out = address;
+    return p;
+
+}
+
+bool parse_ipv4(std::string_view str, uint32_t & out) {
+    const unsigned char * p = reinterpret_cast<const unsigned char*>(str.data());
+    const unsigned char * end = p + str.size();
+    return _parse_address(p, end, out) == end;
+}
+
+bool parse_ipv4_cidr(std::string_view str, ipv4_prefix & out) {
+
+    const unsigned char * p = reinterpret_cast<const unsigned char*>(str.data());
+    const unsigned char * end = p + str.size();
+
+    uint32_t address;
+    p = _parse_address(p, end, address);
+    if (p == nullptr) return false;
+
+    // a bare address is a host route
+    uint32_t length = 32;
+    if (p != end) {
+        // the length is one or two digits, no leading zeros
+        if (*p != '/' || end - p < 2 || end - p > 3) return false;
+        uint32_t a = _digit(p[1]);
+        if (a > 9) return false;
+        length = a;
+        if (end - p == 3) {
+            uint32_t b = _digit(p[2]);
+            if (b > 9 || a == 0) return false;
+            length = a * 10 + b;
+        }
+        if (length > 32) return false;
+    }
+
+    out.length = static_cast<uint8_t>(length);
+    out.network = address & ipv4_mask(out.length);
+    return true;
+
+}
+
+size_t parse_ipv4_cidr_lines(std::string_view text, std::vector<ipv4_prefix> & prefixes, std::vector<std::string_view> & others) {
+
+    size_t lines = 0;
+    const char * p = text.data();
+    const char * end = p + text.size();
+
+    while (p < end) {
+        const char * newline = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        if (newline == nullptr) newline = end;
+
+        // tolerate CRLF files and skip blank lines
+        const char * stop = newline;
+        if (stop > p && stop[-1] == '\r') --stop;
+        std::string_view line(p, static_cast<size_t>(stop - p));
+        p = newline + 1;
+        if (line.empty()) continue;
+
+        ++lines;
+        ipv4_prefix prefix;
+        if (parse_ipv4_cidr(line, prefix)) prefixes.push_back(prefix);
+        else others.push_back(line);
+    }
+
+    return lines;
+
+}
+
+// the last address covered by prefix, as 64 bits so /0 does not overflow
+static uint64_t _last_address(const ipv4_prefix & prefix) {
+    return static_cast<uint64_t>(prefix.network) + (uint64_t(1) << (32 - prefix.length)) - 1;
+}
+
+size_t aggregate_ipv4_prefixes(std::vector<ipv4_prefix> & prefixes) {
+
+    size_t before = prefixes.size();
+
+    // by network, and shorter first, so a covering prefix always precedes what it covers
+    if (!std::is_sorted(prefixes.begin(), prefixes.end())) std::sort(prefixes.begin(), prefixes.end());
+
+    // drop anything inside the last kept prefix: duplicates and covered prefixes alike
+    size_t kept = 0;
+    for (const ipv4_prefix & prefix : prefixes) {
+        if (kept > 0 && _last_address(prefix) <= _last_address(prefixes[kept - 1])) continue;
+        prefixes[kept++] = prefix;
+    }
+
+    // the rest are disjoint; fold each pair of siblings into their parent, which may pair up again
+    size_t top = 0;
+    for (size_t i = 0; i < kept; ++i) {
+        prefixes[top++] = prefixes[i];
+        while (top >= 2) {
+            ipv4_prefix & low = prefixes[top - 2];
+            const ipv4_prefix & high = prefixes[top - 1];
+            if (low.length != high.length || low.length == 0) break;
+
+            uint32_t half = uint32_t(1) << (32 - low.length);
+            if ((low.network & half) != 0 || high.network != (low.network | half)) break;
+
+            --low.length;
+            --top;
+        }
+    }
+
+    prefixes.resize(top);
+    return before - top;
+
+}
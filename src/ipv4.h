@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/**
+ * ## IPv4 Prefix
+ * @brief A parsed IPv4 CIDR entry. The network is stored in host byte order
+ * with all bits past the prefix length cleared.
+ */
+struct ipv4_prefix {
+    uint32_t network;
+    uint8_t length;
+};
+
+// by network, then shorter first, so a covering prefix precedes what it covers
+inline bool operator<(const ipv4_prefix & a, const ipv4_prefix & b) {
+    return a.network != b.network ? a.network < b.network : a.length < b.length;
+}
+
+/*
+    Returns the netmask for a prefix length in [0, 32].
+*/
+inline uint32_t ipv4_mask(uint8_t length) {
+    return length == 0 ? 0u : ~0u << (32 - length);
+}
+
+/**
+    @brief Parses a dotted-quad address ("a.b.c.d") into host byte order.
+
+    @param str the text to parse.
+    @param out receives the address on success.
+    @return true if str is exactly one well-formed IPv4 address.
+**/
+bool parse_ipv4(std::string_view str, uint32_t & out);
+
+/**
+    @brief Parses an IPv4 CIDR ("a.b.c.d/len"). A bare address is treated as a /32.
+    Host bits past the prefix length are cleared.
+
+    @param str the text to parse.
+    @param out receives the prefix on success.
+    @return true if str is exactly one well-formed IPv4 prefix.
+**/
+bool parse_ipv4_cidr(std::string_view str, ipv4_prefix & out);
+
+/**
+    @brief Splits text into lines and parses each as an IPv4 CIDR entry.
+    Blank lines are skipped and a trailing '\r' is dropped.
+
+    @param text the whole block list, e.g. a file read or mapped into memory.
+    @param prefixes receives every line that parses, in order.
+    @param others receives the remaining lines, as views into text.
+    @return the number of non-blank lines.
+**/
+size_t parse_ipv4_cidr_lines(std::string_view text, std::vector<ipv4_prefix> & prefixes, std::vector<std::string_view> & others);
+
+/**
+    @brief Reduces prefixes to the smallest sorted list covering exactly the same addresses.
+    Duplicates and prefixes inside a shorter one are dropped, and sibling pairs
+    (two halves of one parent) are merged into the parent, repeatedly.
+
+    @param prefixes the list to normalize in place; host bits must already be cleared.
+    A list already in operator< order is not sorted again.
+    @return the number of entries removed.
+**/
+size_t aggregate_ipv4_prefixes(std::vector<ipv4_prefix> & prefixes);
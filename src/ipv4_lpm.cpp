@@ -0,0 +1,174 @@
+#include "ipv4_lpm.h"
+#include "parallel.h"
+#include "prefetch.h"
+
+void ipv4_lpm::_push(std::vector<uint32_t> & table, size_t index, uint32_t value, bool force) {
+
+    uint32_t entry = table[index];
+
+    // push the prefix down into every entry of the child chunk
+    if (entry & CHILD) {
+        size_t base = (entry & ~CHILD) * CHUNK_SIZE;
+        for (size_t i = 0; i < CHUNK_SIZE; ++i) this->_push(this->_chunks, base + i, value, force);
+        return;
+    }
+
+    // only overwrite entries owned by a shorter prefix, unless removing
+    if (force || entry < value) table[index] = value;
+
+}
+
+size_t ipv4_lpm::_child(std::vector<uint32_t> & table, size_t index) {
+
+    uint32_t entry = table[index];
+    if (entry & CHILD) return (entry & ~CHILD) * CHUNK_SIZE;
+
+    // create a chunk that inherits the entry's current match
+    size_t chunk = this->_chunks.size() / CHUNK_SIZE;
+    this->_chunks.resize(this->_chunks.size() + CHUNK_SIZE, entry);
+    table[index] = CHILD | static_cast<uint32_t>(chunk);
+
+    return chunk * CHUNK_SIZE;
+
+}
+
+void ipv4_lpm::_assign(uint32_t network, uint8_t length, uint32_t value, bool force, size_t first_slot, size_t last_slot) {
+
+    // short prefixes expand over a range of root entries
+    if (length <= 16) {
+        size_t first = network >> 16;
+        size_t last = first + (size_t(1) << (16 - length));
+        if (first < first_slot) first = first_slot;
+        if (last > last_slot) last = last_slot;
+        for (size_t i = first; i < last; ++i) this->_push(this->_root, i, value, force);
+        return;
+    }
+
+    // otherwise descend into (or create) the second level chunk
+    if ((network >> 16) < first_slot || (network >> 16) >= last_slot) return;
+    size_t base = this->_child(this->_root, network >> 16);
+    if (length <= 24) {
+        size_t first = (network >> 8) & 0xff;
+        size_t count = size_t(1) << (24 - length);
+        for (size_t i = 0; i < count; ++i) this->_push(this->_chunks, base + first + i, value, force);
+        return;
+    }
+
+    // and finally the third level chunk
+    base = this->_child(this->_chunks, base + ((network >> 8) & 0xff));
+    size_t first = network & 0xff;
+    size_t count = size_t(1) << (32 - length);
+    for (size_t i = 0; i < count; ++i) this->_push(this->_chunks, base + first + i, value, force);
+
+}
+
+void ipv4_lpm::insert(uint32_t network, uint8_t length) {
+
+    if (length > 32) return;
+    ++this->_size;
+    this->_assign(network & ipv4_mask(length), length, static_cast<uint32_t>(length) + 1, false, 0, ROOT_SIZE);
+
+}
+
+void ipv4_lpm::remove(uint32_t network, uint8_t length, int covering, const ipv4_prefix * inside, size_t count) {
+
+    if (length > 32 || covering >= length) return;
+    if (this->_size > 0) --this->_size;
+    this->_assign(network & ipv4_mask(length), length, static_cast<uint32_t>(covering + 1), true, 0, ROOT_SIZE);
+
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t inner = inside[i].length;
+        if (inner > 32) continue;
+        this->_assign(inside[i].network & ipv4_mask(inner), inner, static_cast<uint32_t>(inner) + 1, false, 0, ROOT_SIZE);
+    }
+
+}
+
+void ipv4_lpm::insert_parallel(const ipv4_prefix * prefixes, size_t count, size_t threads) {
+
+    threads = parallel_threads(threads, count, 1u << 14);
+    if (threads == 1 || this->_size != 0) {
+        for (size_t i = 0; i < count; ++i) this->insert(prefixes[i]);
+        return;
+    }
+
+    // thread t owns the root entries from slot(t) up to slot(t + 1), so entry s belongs to s * threads / ROOT_SIZE
+    auto slot = [threads](size_t t) { return (ROOT_SIZE * t + threads - 1) / threads; };
+    auto owner = [threads](size_t s) { return s * threads / ROOT_SIZE; };
+
+    // group the prefixes by the threads whose root entries they cover; a short one can cover several
+    std::vector<size_t> starts;
+    std::vector<size_t> order = partition_by_owner(count, threads, [prefixes, owner](size_t i) {
+        uint8_t length = prefixes[i].length;
+        if (length > 32) return std::make_pair(size_t(0), size_t(0));
+        size_t first = (prefixes[i].network & ipv4_mask(length)) >> 16;
+        size_t last = length <= 16 ? first + (size_t(1) << (16 - length)) : first + 1;
+        return std::make_pair(owner(first), owner(last - 1) + 1);
+    }, starts);
+
+    // every thread builds the root entries in its range, with chunks numbered from 0 in its own pool
+    std::vector<ipv4_lpm> parts(threads);
+    parallel_for(threads, [&](size_t t) {
+        for (size_t k = starts[t]; k < starts[t + 1]; ++k) {
+            const ipv4_prefix & prefix = prefixes[order[k]];
+            parts[t]._assign(prefix.network & ipv4_mask(prefix.length), prefix.length, static_cast<uint32_t>(prefix.length) + 1, false, slot(t), slot(t + 1));
+        }
+    });
+    std::vector<size_t>().swap(order);
+
+    // lay the pools end to end, and renumber each part's child pointers by where its pool starts
+    std::vector<size_t> bases(threads + 1, 0);
+    for (size_t t = 0; t < threads; ++t) bases[t + 1] = bases[t] + parts[t].chunk_count();
+    this->_chunks.resize(bases[threads] * CHUNK_SIZE);
+
+    parallel_for(threads, [&](size_t t) {
+        uint32_t base = static_cast<uint32_t>(bases[t]);
+        auto relocate = [base](uint32_t entry) { return (entry & CHILD) ? entry + base : entry; };
+
+        for (size_t i = slot(t); i < slot(t + 1); ++i) this->_root[i] = relocate(parts[t]._root[i]);
+        uint32_t * out = this->_chunks.data() + bases[t] * CHUNK_SIZE;
+        for (uint32_t entry : parts[t]._chunks) *out++ = relocate(entry);
+
+        // free each pool as soon as it is copied
+        std::vector<uint32_t>().swap(parts[t]._chunks);
+    });
+
+    for (size_t i = 0; i < count; ++i) this->_size += prefixes[i].length <= 32;
+
+}
+
+void ipv4_lpm::contains_batch(const uint32_t * addresses, size_t count, bool * out) const {
+
+    uint32_t entries[BATCH_SIZE];
+
+    for (size_t base = 0; base < count; base += BATCH_SIZE) {
+        size_t n = count - base < BATCH_SIZE ? count - base : BATCH_SIZE;
+        const uint32_t * group = addresses + base;
+
+        // prefetch the root entries of the whole group
+        for (size_t i = 0; i < n; ++i) MAP_PREFETCH(&this->_root[group[i] >> 16]);
+
+        // read them and prefetch the second level where there is one
+        for (size_t i = 0; i < n; ++i) {
+            entries[i] = this->_root[group[i] >> 16];
+            if (entries[i] & CHILD)
+                MAP_PREFETCH(&this->_chunks[(entries[i] & ~CHILD) * CHUNK_SIZE + ((group[i] >> 8) & 0xff)]);
+        }
+
+        // step down once more, prefetching the third level
+        for (size_t i = 0; i < n; ++i) {
+            if (!(entries[i] & CHILD)) continue;
+            entries[i] = this->_chunks[(entries[i] & ~CHILD) * CHUNK_SIZE + ((group[i] >> 8) & 0xff)];
+            if (entries[i] & CHILD)
+                MAP_PREFETCH(&this->_chunks[(entries[i] & ~CHILD) * CHUNK_SIZE + (group[i] & 0xff)]);
+        }
+
+        // finish the walk
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t entry = entries[i];
+            if (entry & CHILD) entry = this->_chunks[(entry & ~CHILD) * CHUNK_SIZE + (group[i] & 0xff)];
+            out[base + i] = entry != 0;
+        }
+    }
+
+}
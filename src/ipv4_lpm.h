@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ipv4.h"
+
+/**
+ * ## IPv4 Longest Prefix Match
+ * @brief A multibit trie with strides 16/8/8 over IPv4 addresses.
+ *
+ * The root is a direct table indexed by the top 16 bits of the address, and
+ * longer prefixes hang 256-entry chunks off it for the next 8 bits and then
+ * the last 8. Prefixes are expanded into every entry they cover (controlled
+ * prefix expansion) and pushed down into child chunks, so a lookup is at
+ * most three dependent array reads no matter how many prefixes are loaded.
+ *
+ * Each entry is either a child pointer (high bit set, the rest is a chunk
+ * index) or the length + 1 of the longest prefix covering it (0 = no match).
+ */
+class ipv4_lpm {
+    public:
+        static constexpr uint32_t CHILD = 0x80000000u;
+        static constexpr size_t ROOT_SIZE = 1u << 16;
+        static constexpr size_t CHUNK_SIZE = 1u << 8;
+
+    private:
+        static constexpr size_t BATCH_SIZE = 16;
+
+        std::vector<uint32_t> _root;
+        std::vector<uint32_t> _chunks;
+        size_t _size;
+
+        void _push(std::vector<uint32_t> & table, size_t index, uint32_t value, bool force);
+        size_t _child(std::vector<uint32_t> & table, size_t index);
+
+        // write value over a masked prefix's entries (all of them if force, else those of shorter prefixes),
+        // touching only root entries in [first_slot, last_slot) and what hangs off them
+        void _assign(uint32_t network, uint8_t length, uint32_t value, bool force, size_t first_slot, size_t last_slot);
+
+    public:
+        ipv4_lpm() : _root(ROOT_SIZE, 0), _chunks(), _size(0) {}
+
+        /**
+            @brief Adds a prefix. Host bits past length are ignored.
+
+            @param network the network address in host byte order.
+            @param length the prefix length in [0, 32].
+        **/
+        void insert(uint32_t network, uint8_t length);
+        void insert(const ipv4_prefix & prefix) { this->insert(prefix.network, prefix.length); }
+
+        /**
+            @brief Adds count prefixes on up to threads threads (0 means one per core). Each thread
+            owns a range of root entries; the prefixes are grouped once by the ranges they cover,
+            and each thread assigns only its group into its own chunk pool. The pools are then
+            appended and their child pointers renumbered. The result looks up the same as count inserts.
+            A table that already holds prefixes is filled serially.
+        **/
+        void insert_parallel(const ipv4_prefix * prefixes, size_t count, size_t threads = 0);
+
+        /**
+            @brief Removes a prefix. Every address it covers, under longer prefixes too, goes back
+            to the enclosing prefix of length covering, and then the prefixes inside it that stay
+            are written back. Chunks are kept, so the work is proportional to the prefix's range.
+
+            @param network the network address in host byte order.
+            @param length the prefix length in [0, 32].
+            @param covering the length of the longest remaining prefix enclosing this one, or -1 if none does.
+            @param inside the remaining prefixes longer than length within it.
+            @param count the number of prefixes in inside.
+        **/
+        void remove(uint32_t network, uint8_t length, int covering, const ipv4_prefix * inside, size_t count);
+
+        /**
+            @brief Returns the length of the longest prefix covering address, or -1 if none does.
+
+            @param address the address in host byte order.
+        **/
+        int longest_match(uint32_t address) const {
+            return longest_match(this->_root.data(), this->_chunks.data(), address);
+        }
+
+        /**
+            @brief The lookup over raw tables, so a serialized copy (e.g. a mapped snapshot) can be searched in place.
+
+            @param root the ROOT_SIZE root entries.
+            @param chunks the concatenated CHUNK_SIZE-entry chunks.
+            @param address the address in host byte order.
+        **/
+        static int longest_match(const uint32_t * root, const uint32_t * chunks, uint32_t address) {
+            uint32_t entry = root[address >> 16];
+            if (entry & CHILD) {
+                entry = chunks[(entry & ~CHILD) * CHUNK_SIZE + ((address >> 8) & 0xff)];
+                if (entry & CHILD)
+                    entry = chunks[(entry & ~CHILD) * CHUNK_SIZE + (address & 0xff)];
+            }
+            return static_cast<int>(entry) - 1;
+        }
+
+        bool contains(uint32_t address) const { return this->longest_match(address) >= 0; }
+
+        /**
+            @brief Writes contains(addresses[i]) to out[i], prefetching each level for a
+            whole group of addresses before reading any of them.
+        **/
+        void contains_batch(const uint32_t * addresses, size_t count, bool * out) const;
+
+        size_t size() const noexcept { return this->_size; }
+
+        const std::vector<uint32_t> & root_table() const noexcept { return this->_root; }
+        const std::vector<uint32_t> & chunk_table() const noexcept { return this->_chunks; }
+
+        size_t chunk_count() const noexcept { return this->_chunks.size() / CHUNK_SIZE; }
+
+        size_t memory_usage() const noexcept {
+            return (this->_root.capacity() + this->_chunks.capacity()) * sizeof(uint32_t);
+        }
+};
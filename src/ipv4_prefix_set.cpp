@@ -0,0 +1,83 @@
+#include "ipv4_prefix_set.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "parallel.h"
+
+void ipv4_prefix_set::insert(uint32_t network, uint8_t length) {
+    if (length >= LENGTHS) return;
+    this->_networks[length].push_back(network & ipv4_mask(length));
+    this->_lengths |= uint64_t(1) << length;
+}
+
+void ipv4_prefix_set::build(size_t threads) {
+
+    // lengths are dealt out round robin, as a list usually crowds a few of them
+    threads = parallel_threads(threads, LENGTHS, 1);
+    parallel_for(threads, [this, threads](size_t t) {
+        for (size_t length = t; length < LENGTHS; length += threads) {
+            std::vector<uint32_t> & networks = this->_networks[length];
+            std::sort(networks.begin(), networks.end());
+            networks.erase(std::unique(networks.begin(), networks.end()), networks.end());
+            networks.shrink_to_fit();
+        }
+    });
+
+    this->_size = 0;
+    for (const std::vector<uint32_t> & networks : this->_networks) this->_size += networks.size();
+
+}
+
+void ipv4_prefix_set::update(std::vector<ipv4_prefix> added, std::vector<ipv4_prefix> removed) {
+
+    auto by_length = [](const ipv4_prefix & a, const ipv4_prefix & b) {
+        return a.length != b.length ? a.length < b.length : a.network < b.network;
+    };
+    for (ipv4_prefix & prefix : added) prefix.network &= ipv4_mask(prefix.length);
+    for (ipv4_prefix & prefix : removed) prefix.network &= ipv4_mask(prefix.length);
+    std::sort(added.begin(), added.end(), by_length);
+    std::sort(removed.begin(), removed.end(), by_length);
+
+    // one merge per length: drop the removed networks, then fold in the added ones
+    size_t a = 0, r = 0;
+    std::vector<uint32_t> kept, changes, merged;
+    while (a < added.size() || r < removed.size()) {
+        uint8_t length = a == added.size() ? removed[r].length
+                       : r == removed.size() ? added[a].length : std::min(added[a].length, removed[r].length);
+        if (length >= LENGTHS) break;
+        std::vector<uint32_t> & networks = this->_networks[length];
+
+        changes.clear();
+        for (; r < removed.size() && removed[r].length == length; ++r) changes.push_back(removed[r].network);
+        kept.clear();
+        std::set_difference(networks.begin(), networks.end(), changes.begin(), changes.end(), std::back_inserter(kept));
+
+        changes.clear();
+        for (; a < added.size() && added[a].length == length; ++a) changes.push_back(added[a].network);
+        merged.clear();
+        std::set_union(kept.begin(), kept.end(), changes.begin(), changes.end(), std::back_inserter(merged));
+
+        this->_size += merged.size();
+        this->_size -= networks.size();
+        networks.swap(merged);
+        if (networks.empty()) this->_lengths &= ~(uint64_t(1) << length);
+        else this->_lengths |= uint64_t(1) << length;
+    }
+
+}
+
+int ipv4_prefix_set::longest_match(uint32_t address) const {
+
+    // walk the present lengths from longest to shortest
+    for (uint64_t lengths = this->_lengths; lengths != 0; ) {
+        int length = 63 - __builtin_clzll(lengths);
+        lengths &= ~(uint64_t(1) << length);
+
+        const std::vector<uint32_t> & networks = this->_networks[length];
+        uint32_t network = address & ipv4_mask(static_cast<uint8_t>(length));
+        if (contains(networks.data(), networks.size(), network)) return length;
+    }
+    return -1;
+
+}
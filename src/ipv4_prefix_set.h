@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ipv4.h"
+
+/**
+ * ## IPv4 Prefix Set
+ * @brief A compact set of IPv4 prefixes: one sorted array of network addresses per prefix length.
+ *
+ * Each prefix costs four bytes, and a lookup is a binary search in the array
+ * for its length. A bitmask of the lengths that are present lets address
+ * lookups skip the empty arrays, and a block list typically uses only a few
+ * lengths.
+ *
+ * Inserts are appended unsorted. Call build() after the last insert and
+ * before any lookup.
+ */
+class ipv4_prefix_set {
+    public:
+        static constexpr size_t LENGTHS = 33;
+
+    private:
+        std::vector<uint32_t> _networks[LENGTHS];
+        uint64_t _lengths;
+        size_t _size;
+
+    public:
+        ipv4_prefix_set() : _networks(), _lengths(0), _size(0) {}
+
+        /**
+            @brief Adds a prefix. Host bits past length are ignored.
+
+            @param network the network address in host byte order.
+            @param length the prefix length in [0, 32].
+        **/
+        void insert(uint32_t network, uint8_t length);
+        void insert(const ipv4_prefix & prefix) { this->insert(prefix.network, prefix.length); }
+
+        /**
+            @brief Sorts each length's networks and drops duplicates, making the set searchable.
+
+            @param threads how many threads sort, each taking whole lengths; 0 means one per core.
+        **/
+        void build(size_t threads = 1);
+
+        /**
+            @brief Adds and removes prefixes in a built set, which stays searchable. Each length
+            that changes is merged once, so a batch costs one copy of every length it touches,
+            however few of its networks change: linear in the list, not in the batch.
+
+            @param added prefixes to add; ones already present are ignored.
+            @param removed prefixes to remove; ones not present are ignored.
+        **/
+        void update(std::vector<ipv4_prefix> added, std::vector<ipv4_prefix> removed);
+
+        /**
+            @brief Determines if exactly this prefix is in the set.
+        **/
+        bool contains(const ipv4_prefix & prefix) const {
+            if (prefix.length >= LENGTHS) return false;
+            const std::vector<uint32_t> & networks = this->_networks[prefix.length];
+            return contains(networks.data(), networks.size(), prefix.network);
+        }
+
+        /**
+            @brief The search over a raw sorted array, so a serialized copy can be searched in place.
+        **/
+        static bool contains(const uint32_t * networks, size_t count, uint32_t network) {
+            // branch-light lower bound
+            const uint32_t * first = networks;
+            while (count > 1) {
+                size_t half = count / 2;
+                if (first[half] <= network) first += half;
+                count -= half;
+            }
+            return count == 1 && *first == network;
+        }
+
+        /**
+            @brief Returns the length of the longest prefix covering address, or -1 if none does.
+            One search per length present, longest first.
+        **/
+        int longest_match(uint32_t address) const;
+
+        /**
+            @brief The networks of one length, sorted once build() has run.
+        **/
+        const std::vector<uint32_t> & networks(uint8_t length) const { return this->_networks[length]; }
+
+        /**
+            @brief Bit L is set when some prefix of length L is present.
+        **/
+        uint64_t lengths() const noexcept { return this->_lengths; }
+
+        size_t size() const noexcept { return this->_size; }
+
+        size_t memory_usage() const noexcept {
+            size_t bytes = 0;
+            for (const std::vector<uint32_t> & networks : this->_networks) bytes += networks.capacity() * sizeof(uint32_t);
+            return bytes;
+        }
+};
@@ -0,0 +1,101 @@
+#include "ipv6.h"
+#include "ipv4.h"
+
+// the value of a hex digit, or 16 for any other byte
+static inline uint32_t _hex(char c) {
+    uint32_t digit = static_cast<uint32_t>(static_cast<unsigned char>(c)) - '0';
+    if (digit < 10) return digit;
+    uint32_t letter = static_cast<uint32_t>(static_cast<unsigned char>(c) | 0x20) - 'a';
+    return letter < 6 ? letter + 10 : 16;
+}
+
+bool parse_ipv6(std::string_view str, ipv6_address & out) {
+
+    uint16_t groups[8] = { };
+    int count = 0;
+    int gap = -1;   // how many groups came before the "::", if there was one
+
+    const char * p = str.data();
+    const char * end = p + str.size();
+    if (p == end) return false;
+
+    // a leading "::"; a single leading ':' is malformed
+    if (*p == ':') {
+        if (end - p < 2 || p[1] != ':') return false;
+        gap = 0;
+        p += 2;
+    }
+
+    while (p < end) {
+        // one to four hex digits
+        const char * q = p;
+        uint32_t value = 0;
+        while (q < end && q - p < 4 && _hex(*q) < 16) value = (value << 4) | _hex(*q++);
+        if (q == p) return false;
+
+        // a dotted quad can only be the last 32 bits
+        if (q < end && *q == '.') {
+            uint32_t v4;
+            if (count > 6 || !parse_ipv4(std::string_view(p, static_cast<size_t>(end - p)), v4)) return false;
+            groups[count++] = static_cast<uint16_t>(v4 >> 16);
+            groups[count++] = static_cast<uint16_t>(v4);
+            break;
+        }
+
+        if (count == 8) return false;
+        groups[count++] = static_cast<uint16_t>(value);
+        p = q;
+        if (p == end) break;
+
+        // a group ends at ':' (which catches a fifth digit), and "::" may appear once
+        if (*p != ':' || ++p == end) return false;
+        if (*p == ':') {
+            if (gap >= 0) return false;
+            gap = count;
+            ++p;
+        }
+    }
+
+    // without "::" every group is written; with it, it stands for at least one zero group
+    if (gap < 0 ? count != 8 : count > 7) return false;
+
+    uint16_t expanded[8] = { };
+    if (gap < 0) gap = count;
+    for (int i = 0; i < gap; ++i) expanded[i] = groups[i];
+    for (int i = gap; i < count; ++i) expanded[8 - count + i] = groups[i];
+
+    out.high = 0;
+    out.low = 0;
+    for (int i = 0; i < 4; ++i) out.high = (out.high << 16) | expanded[i];
+    for (int i = 4; i < 8; ++i) out.low = (out.low << 16) | expanded[i];
+    return true;
+
+}
+
+bool parse_ipv6_cidr(std::string_view str, ipv6_prefix & out) {
+
+    size_t slash = str.find('/');
+
+    ipv6_address address;
+    if (!parse_ipv6(str.substr(0, slash), address)) return false;
+
+    // a bare address is a host route
+    uint32_t length = 128;
+    if (slash != std::string_view::npos) {
+        // one to three digits, no leading zeros
+        std::string_view digits = str.substr(slash + 1);
+        if (digits.empty() || digits.size() > 3 || (digits.size() > 1 && digits[0] == '0')) return false;
+        length = 0;
+        for (char c : digits) {
+            uint32_t digit = static_cast<uint32_t>(static_cast<unsigned char>(c)) - '0';
+            if (digit > 9) return false;
+            length = length * 10 + digit;
+        }
+        if (length > 128) return false;
+    }
+
+    out.length = static_cast<uint8_t>(length);
+    out.network = ipv6_mask(address, out.length);
+    return true;
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/**
+ * ## IPv6 Address
+ * @brief A 128-bit address as two host-order halves, so comparing and masking
+ * are plain integer operations whatever text form the address came from.
+ */
+struct ipv6_address {
+    uint64_t high;
+    uint64_t low;
+
+    // the byte at index (0 is the first byte on the wire)
+    uint8_t byte(size_t index) const {
+        uint64_t half = index < 8 ? this->high : this->low;
+        return static_cast<uint8_t>(half >> (56 - 8 * (index & 7)));
+    }
+};
+
+inline bool operator==(const ipv6_address & a, const ipv6_address & b) { return a.high == b.high && a.low == b.low; }
+inline bool operator<(const ipv6_address & a, const ipv6_address & b) {
+    return a.high != b.high ? a.high < b.high : a.low < b.low;
+}
+
+/**
+ * ## IPv6 Prefix
+ * @brief A parsed IPv6 CIDR entry, with all bits past the prefix length cleared.
+ */
+struct ipv6_prefix {
+    ipv6_address network;
+    uint8_t length;
+};
+
+inline bool operator==(const ipv6_prefix & a, const ipv6_prefix & b) { return a.network == b.network && a.length == b.length; }
+inline bool operator<(const ipv6_prefix & a, const ipv6_prefix & b) {
+    return a.network == b.network ? a.length < b.length : a.network < b.network;
+}
+
+/*
+    Returns address with every bit past length (in [0, 128]) cleared.
+*/
+inline ipv6_address ipv6_mask(const ipv6_address & address, uint8_t length) {
+    uint64_t high = length == 0 ? 0 : length >= 64 ? ~uint64_t(0) : ~uint64_t(0) << (64 - length);
+    uint64_t low = length <= 64 ? 0 : length >= 128 ? ~uint64_t(0) : ~uint64_t(0) << (128 - length);
+    return ipv6_address { address.high & high, address.low & low };
+}
+
+/**
+    @brief Parses any RFC 4291 text form of an IPv6 address: full, "::"-compressed,
+    and with a trailing dotted-quad ("::ffff:192.0.2.1"). Hex digits may be either case.
+    Zone indices ("%eth0") are not accepted.
+
+    @param str the text to parse.
+    @param out receives the address on success.
+    @return true if str is exactly one well-formed IPv6 address.
+**/
+bool parse_ipv6(std::string_view str, ipv6_address & out);
+
+/**
+    @brief Parses an IPv6 CIDR ("addr/len", len in [0, 128]). A bare address is treated as a /128.
+    Host bits past the prefix length are cleared.
+
+    @param str the text to parse.
+    @param out receives the prefix on success.
+    @return true if str is exactly one well-formed IPv6 prefix.
+**/
+bool parse_ipv6_cidr(std::string_view str, ipv6_prefix & out);
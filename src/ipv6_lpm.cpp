@@ -0,0 +1,73 @@
+#include "ipv6_lpm.h"
+
+void ipv6_lpm::_push(std::vector<uint32_t> & table, size_t index, uint32_t value, bool force) {
+
+    uint32_t entry = table[index];
+
+    // push the prefix down into every entry of the child chunk
+    if (entry & CHILD) {
+        size_t base = (entry & ~CHILD) * CHUNK_SIZE;
+        for (size_t i = 0; i < CHUNK_SIZE; ++i) this->_push(this->_chunks, base + i, value, force);
+        return;
+    }
+
+    // only overwrite entries owned by a shorter prefix, unless removing
+    if (force || entry < value) table[index] = value;
+
+}
+
+size_t ipv6_lpm::_child(std::vector<uint32_t> & table, size_t index) {
+
+    uint32_t entry = table[index];
+    if (entry & CHILD) return (entry & ~CHILD) * CHUNK_SIZE;
+
+    // create a chunk that inherits the entry's current match
+    size_t chunk = this->_chunks.size() / CHUNK_SIZE;
+    this->_chunks.resize(this->_chunks.size() + CHUNK_SIZE, entry);
+    table[index] = CHILD | static_cast<uint32_t>(chunk);
+
+    return chunk * CHUNK_SIZE;
+
+}
+
+void ipv6_lpm::insert(const ipv6_address & address, uint8_t length) {
+
+    if (length > 128) return;
+    ++this->_size;
+    this->_assign(ipv6_mask(address, length), length, static_cast<uint32_t>(length) + 1, false);
+
+}
+
+void ipv6_lpm::remove(const ipv6_prefix & prefix, int covering, const ipv6_prefix * inside, size_t count) {
+
+    if (prefix.length > 128 || covering >= prefix.length) return;
+    if (this->_size > 0) --this->_size;
+    this->_assign(ipv6_mask(prefix.network, prefix.length), prefix.length, static_cast<uint32_t>(covering + 1), true);
+
+    for (size_t i = 0; i < count; ++i) {
+        if (inside[i].length > 128) continue;
+        this->_assign(ipv6_mask(inside[i].network, inside[i].length), inside[i].length, static_cast<uint32_t>(inside[i].length) + 1, false);
+    }
+
+}
+
+void ipv6_lpm::_assign(const ipv6_address & network, uint8_t length, uint32_t value, bool force) {
+
+    // short prefixes expand over a range of root entries
+    if (length <= 16) {
+        size_t first = network.high >> 48;
+        size_t count = size_t(1) << (16 - length);
+        for (size_t i = 0; i < count; ++i) this->_push(this->_root, first + i, value, force);
+        return;
+    }
+
+    // descend a byte at a time until the level the prefix ends in
+    size_t base = this->_child(this->_root, network.high >> 48);
+    size_t index = 2;
+    for (; length > 8 * (index + 1); ++index) base = this->_child(this->_chunks, base + network.byte(index));
+
+    size_t first = network.byte(index);
+    size_t count = size_t(1) << (8 * (index + 1) - length);
+    for (size_t i = 0; i < count; ++i) this->_push(this->_chunks, base + first + i, value, force);
+
+}
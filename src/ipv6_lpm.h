@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ipv6.h"
+
+/**
+ * ## IPv6 Longest Prefix Match
+ * @brief A multibit trie over IPv6 addresses: a 16-bit root, then 8-bit strides.
+ *
+ * This is ipv4_lpm carried to 128 bits. The root is a direct table indexed
+ * by the first 16 bits, and longer prefixes hang 256-entry chunks off it for
+ * each following byte. Prefixes are expanded into every entry they cover and
+ * pushed down into child chunks, so a lookup reads one entry per level and
+ * stops at the first that is not a child pointer.
+ *
+ * Routed IPv6 prefixes are mostly /32 to /64, which end at levels 3 to 7; a
+ * lookup never takes more than 15 reads whatever the table holds or however
+ * the query was written.
+ *
+ * Entries use ipv4_lpm's encoding: a child pointer (high bit set, the rest is
+ * a chunk index) or the length + 1 of the longest prefix covering it.
+ */
+class ipv6_lpm {
+    public:
+        static constexpr uint32_t CHILD = 0x80000000u;
+        static constexpr size_t ROOT_SIZE = 1u << 16;
+        static constexpr size_t CHUNK_SIZE = 1u << 8;
+
+    private:
+        std::vector<uint32_t> _root;
+        std::vector<uint32_t> _chunks;
+        size_t _size;
+
+        void _push(std::vector<uint32_t> & table, size_t index, uint32_t value, bool force);
+        size_t _child(std::vector<uint32_t> & table, size_t index);
+
+        // write value over a masked prefix's entries: all of them if force, else those of shorter prefixes
+        void _assign(const ipv6_address & network, uint8_t length, uint32_t value, bool force);
+
+    public:
+        ipv6_lpm() : _root(ROOT_SIZE, 0), _chunks(), _size(0) {}
+
+        /**
+            @brief Adds a prefix. Host bits past length are ignored.
+
+            @param network the network address.
+            @param length the prefix length in [0, 128].
+        **/
+        void insert(const ipv6_address & network, uint8_t length);
+        void insert(const ipv6_prefix & prefix) { this->insert(prefix.network, prefix.length); }
+
+        /**
+            @brief Removes a prefix, as ipv4_lpm::remove does: its addresses go back to the enclosing
+            prefix of length covering (-1 if none), and then the count prefixes in inside are written back.
+        **/
+        void remove(const ipv6_prefix & prefix, int covering, const ipv6_prefix * inside, size_t count);
+
+        /**
+            @brief Returns the length of the longest prefix covering address, or -1 if none does.
+        **/
+        int longest_match(const ipv6_address & address) const {
+            uint32_t entry = this->_root[address.high >> 48];
+            for (size_t index = 2; entry & CHILD; ++index)
+                entry = this->_chunks[(entry & ~CHILD) * CHUNK_SIZE + address.byte(index)];
+            return static_cast<int>(entry) - 1;
+        }
+
+        bool contains(const ipv6_address & address) const { return this->longest_match(address) >= 0; }
+
+        size_t size() const noexcept { return this->_size; }
+
+        size_t chunk_count() const noexcept { return this->_chunks.size() / CHUNK_SIZE; }
+
+        size_t memory_usage() const noexcept {
+            return (this->_root.capacity() + this->_chunks.capacity()) * sizeof(uint32_t);
+        }
+};
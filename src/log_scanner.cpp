@@ -0,0 +1,274 @@
+#include "log_scanner.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// byte classes, gathered for a whole token as it is cut out so most tokens are dismissed without another look
+enum : unsigned char { _DELIMITER = 1, _DOT = 2, _COLON = 4, _EQUALS = 8, _ALPHA = 16 };
+
+/*
+    One entry per byte. Delimiters end a token: whitespace and the quoting
+    and separating punctuation of common log formats. '=' is not one, so a
+    URL keeps its query, and neither are brackets, for "[2001:db8::1]:443".
+*/
+struct _byte_classes {
+    unsigned char map[256];
+
+    constexpr _byte_classes() : map() {
+        for (unsigned char c : { ' ', '\t', '\r', '\n', '\v', '\f', '"', '\'', ',', ';', '(', ')', '<', '>', '{', '}', '|', '\0' })
+            map[c] = _DELIMITER;
+        for (int c = 'a'; c <= 'z'; ++c) map[c] = _ALPHA;
+        for (int c = 'A'; c <= 'Z'; ++c) map[c] = _ALPHA;
+        map[static_cast<unsigned char>('.')] = _DOT;
+        map[static_cast<unsigned char>(':')] = _COLON;
+        map[static_cast<unsigned char>('=')] = _EQUALS;
+    }
+};
+
+static constexpr _byte_classes _classes;
+
+static inline bool _is_digit(char c) { return static_cast<unsigned char>(c - '0') < 10; }
+static inline bool _is_alpha(char c) { return static_cast<unsigned char>((c | 0x20) - 'a') < 26; }
+
+// reads until size bytes are in, or the input ends; returns how many, or -1 on a read error
+static ssize_t _read_fully(int fd, char * buffer, size_t size) {
+    size_t filled = 0;
+    while (filled < size) {
+        ssize_t n = ::read(fd, buffer + filled, size - filled);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return -1;
+        if (n == 0) break;
+        filled += static_cast<size_t>(n);
+    }
+    return static_cast<ssize_t>(filled);
+}
+
+log_scanner::log_scanner(const malicious_url_filter & filter, size_t threads)
+    : _filter(filter), _threads(threads), _totals() {}
+
+void log_scanner::_flush(uint32_t * addresses, match * pending, size_t & batched, piece_result & result) const {
+    bool hits[BATCH_SIZE];
+    this->_filter.is_Malicious_IP_batch(addresses, batched, hits);
+    for (size_t i = 0; i < batched; ++i) if (hits[i]) result.matches.push_back(pending[i]);
+    batched = 0;
+}
+
+void log_scanner::_check(std::string_view token, unsigned classes, uint64_t offset, uint64_t line, piece_result & result,
+                         uint32_t * addresses, match * pending, size_t & batched) const {
+
+    // a URL: the whole entry, then its host, then its substrings
+    if ((classes & _COLON) && token.find("://") != std::string_view::npos) {
+        const char * kind = this->_filter.is_Malicious_URL(token) ? "url"
+                          : this->_filter.is_Malicious_Domain(token) ? "domain"
+                          : this->_filter.is_Malicious_Pattern(token) ? "pattern" : nullptr;
+        if (kind != nullptr) result.matches.push_back(match { offset, line, kind, token });
+        return;
+    }
+
+    // a request path can only hold a pattern
+    if (token.front() == '/') {
+        if (this->_filter.is_Malicious_Pattern(token)) result.matches.push_back(match { offset, line, "pattern", token });
+        return;
+    }
+
+    // addresses and host names all have a dot or a colon; most words and numbers in a log have neither
+    if (!(classes & (_DOT | _COLON))) return;
+
+    // key=value fields (SRC=192.0.2.1 in firewall logs) are checked by value
+    if (classes & _EQUALS) {
+        size_t equals = token.rfind('=');
+        token.remove_prefix(equals + 1);
+        offset += equals + 1;
+    }
+
+    // trailing punctuation: a host ending a sentence, or tcpdump's "addr.port:"
+    if (token.size() > 1 && token.back() == ':' && token[token.size() - 2] != ':') token.remove_suffix(1);
+    while (!token.empty() && token.back() == '.') token.remove_suffix(1);
+    if (token.size() < 2) return;
+
+    // IPv4, also as "addr:port" and tcpdump's "addr.port"
+    if (_is_digit(token.front())) {
+        std::string_view host = token;
+        size_t colon = host.find(':');
+        if (colon != std::string_view::npos && host.find(':', colon + 1) == std::string_view::npos) host = host.substr(0, colon);
+
+        uint32_t address;
+        size_t dots = 0, fourth = 0;
+        for (size_t i = 0; i < host.size() && dots < 4; ++i) if (host[i] == '.' && ++dots == 4) fourth = i;
+        if (parse_ipv4(host, address) || (dots == 4 && parse_ipv4(host.substr(0, fourth), address))) {
+            addresses[batched] = address;
+            pending[batched++] = match { offset, line, "ip", token };
+            if (batched == BATCH_SIZE) this->_flush(addresses, pending, batched, result);
+            return;
+        }
+    }
+
+    // IPv6, bare or bracketed with a port
+    if (classes & _COLON) {
+        std::string_view host = token;
+        if (host.front() == '[') {
+            size_t close = host.find(']');
+            if (close == std::string_view::npos) return;
+            host = host.substr(1, close - 1);
+        }
+        ipv6_address address6;
+        if (parse_ipv6(host, address6)) {
+            if (this->_filter.is_Malicious_IP(address6)) result.matches.push_back(match { offset, line, "ip", token });
+            return;
+        }
+    }
+
+    // anything else may be a host name, if the part before any path has a dot and a letter ("HTTP/1.1" does not)
+    if ((classes & (_DOT | _ALPHA)) != (_DOT | _ALPHA)) return;
+    std::string_view host = token.substr(0, token.find_first_of("/?#"));
+    if (host.find('.') != std::string_view::npos && std::any_of(host.begin(), host.end(), _is_alpha)) {
+        if (this->_filter.is_Malicious_Domain(token)) result.matches.push_back(match { offset, line, "domain", token });
+    }
+
+}
+
+void log_scanner::_scan_piece(std::string_view text, uint64_t offset, piece_result & result) const {
+
+    uint32_t addresses[BATCH_SIZE];
+    match pending[BATCH_SIZE];
+    size_t batched = 0;
+
+    const char * begin = text.data();
+    const char * p = begin;
+    const char * end = begin + text.size();
+    uint64_t line = 0, tokens = 0;
+
+    while (p < end) {
+        // skip to the next token, counting lines on the way
+        while (p < end && _classes.map[static_cast<unsigned char>(*p)] == _DELIMITER) line += *p++ == '\n';
+        const char * q = p;
+        unsigned classes = 0, c;
+        while (q < end && (c = _classes.map[static_cast<unsigned char>(*q)]) != _DELIMITER) {
+            classes |= c;
+            ++q;
+        }
+        if (q == p) break;
+
+        ++tokens;
+        if (q - p >= 2) {
+            this->_check(std::string_view(p, static_cast<size_t>(q - p)), classes, offset + static_cast<uint64_t>(p - begin),
+                         line, result, addresses, pending, batched);
+        }
+        p = q;
+    }
+    if (batched > 0) this->_flush(addresses, pending, batched, result);
+
+    // batched addresses were reported late, so put everything back in input order
+    std::sort(result.matches.begin(), result.matches.end(), [](const match & a, const match & b) { return a.offset < b.offset; });
+    result.lines = line;
+    result.tokens = tokens;
+
+}
+
+void log_scanner::_scan_block(std::string_view block, uint64_t offset, std::string_view name, std::string & out) {
+
+    std::vector<std::string_view> pieces = split_lines(block, block.size() / PIECE_SIZE + 1);
+    std::vector<piece_result> results(pieces.size());
+
+    // workers take the next piece as they finish one, so a slow piece does not hold the others up
+    std::atomic<size_t> next { 0 };
+    parallel_for(parallel_threads(this->_threads, pieces.size(), 1), [&](size_t) {
+        for (size_t i = next.fetch_add(1); i < pieces.size(); i = next.fetch_add(1))
+            this->_scan_piece(pieces[i], offset + static_cast<uint64_t>(pieces[i].data() - block.data()), results[i]);
+    });
+
+    // number lines across the pieces and write the matches in order
+    char numbers[64];
+    for (const piece_result & result : results) {
+        for (const match & m : result.matches) {
+            int n = std::snprintf(numbers, sizeof(numbers), ":%llu:%llu:",
+                                  static_cast<unsigned long long>(this->_totals.lines + m.line + 1),
+                                  static_cast<unsigned long long>(m.offset));
+            out.append(name.data(), name.size()).append(numbers, static_cast<size_t>(n));
+            out.append(m.kind).append(1, ':').append(m.token.data(), m.token.size()).append(1, '\n');
+        }
+        this->_totals.lines += result.lines;
+        this->_totals.tokens += result.tokens;
+        this->_totals.matches += result.matches.size();
+    }
+
+}
+
+bool log_scanner::scan(std::string const & path, FILE * out) {
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    bool from_stdin = path == "-";
+    int fd = from_stdin ? STDIN_FILENO : ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+#ifdef POSIX_FADV_SEQUENTIAL
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    std::string_view name = from_stdin ? std::string_view("(standard input)") : std::string_view(path);
+
+    // a regular file needs blocks no bigger than what is left of it, plus a byte to see that it ended
+    size_t block_size = BLOCK_SIZE;
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        off_t position = ::lseek(fd, 0, SEEK_CUR);
+        uint64_t left = static_cast<uint64_t>(st.st_size) - static_cast<uint64_t>(position > 0 && position <= st.st_size ? position : 0);
+        if (left + 1 < block_size) block_size = static_cast<size_t>(left + 1);
+    }
+
+    // two blocks: the workers scan one while a reader thread fills the other, which is only allocated if needed
+    std::unique_ptr<char[]> blocks[2] = { std::unique_ptr<char[]>(new char[block_size]), nullptr };
+    ssize_t filled = _read_fully(fd, blocks[0].get(), block_size);
+    uint64_t offset = 0;
+    char last_byte = '\n';
+    bool ok = filled >= 0;
+    std::string matches;
+
+    for (size_t current = 0; ok && filled > 0; current ^= 1) {
+        char * block = blocks[current].get();
+        size_t size = static_cast<size_t>(filled);
+        bool more = size == block_size;
+
+        // scan whole lines only; a partial last line moves to the front of the other block
+        size_t cut = size;
+        if (more) {
+            while (cut > 0 && block[cut - 1] != '\n') --cut;
+            if (cut == 0) cut = size;  // one line fills the block, so cut it
+        }
+        if (more && !blocks[current ^ 1]) blocks[current ^ 1].reset(new char[block_size]);
+        char * spare = blocks[current ^ 1].get();
+        size_t carried = size - cut;
+        if (carried > 0) std::copy(block + cut, block + size, spare);
+
+        ssize_t read = 0;
+        std::thread reader;
+        if (more) reader = std::thread([fd, spare, carried, block_size, &read] { read = _read_fully(fd, spare + carried, block_size - carried); });
+
+        matches.clear();
+        this->_scan_block(std::string_view(block, cut), offset, name, matches);
+        if (!matches.empty()) std::fwrite(matches.data(), 1, matches.size(), out);
+        this->_totals.bytes += cut;
+        last_byte = block[cut - 1];
+        offset += cut;
+
+        if (reader.joinable()) reader.join();
+        ok = read >= 0;
+        filled = more ? static_cast<ssize_t>(carried) + read : 0;
+    }
+
+    // a last line without a newline still counts
+    if (offset > 0 && last_byte != '\n') ++this->_totals.lines;
+
+    if (!from_stdin) ::close(fd);
+    this->_totals.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return ok;
+
+}
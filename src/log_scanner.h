@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "malicious_url_filter.h"
+
+/**
+ * ## Log Scanner
+ * @brief Streams text (access logs, flow exports, tcpdump output) through a
+ * filter and reports every blocked address, URL, domain or pattern in it.
+ *
+ * Input is read in blocks of up to BLOCK_SIZE, no bigger than what is left
+ * of a regular file. The next block is read while the workers scan the
+ * current one, cut into pieces of whole lines. Tokens are views
+ * into the block, so nothing is allocated per line. IPv4 addresses are
+ * gathered and looked up in batches. IPv6 addresses, URLs, request paths
+ * and host names are checked as they are found.
+ *
+ * Each match is written as "name:line:offset:kind:token". The offset is the
+ * token's byte offset in the input, and kind is one of ip, url, domain or
+ * pattern. Matches come out in input order.
+ */
+class log_scanner {
+    public:
+        static constexpr size_t BLOCK_SIZE = 64u << 20;
+        static constexpr size_t PIECE_SIZE = 1u << 20;
+        static constexpr size_t BATCH_SIZE = 256;
+
+        struct totals {
+            uint64_t bytes = 0;
+            uint64_t lines = 0;
+            uint64_t tokens = 0;
+            uint64_t matches = 0;
+            double seconds = 0.0;
+        };
+
+    private:
+        struct match {
+            uint64_t offset = 0;
+            uint64_t line = 0;  // within its piece
+            const char * kind = nullptr;
+            std::string_view token {};
+        };
+
+        struct piece_result {
+            std::vector<match> matches {};
+            uint64_t lines = 0;
+            uint64_t tokens = 0;
+        };
+
+        const malicious_url_filter & _filter;
+        size_t _threads;
+        totals _totals;
+
+        void _check(std::string_view token, unsigned classes, uint64_t offset, uint64_t line, piece_result & result,
+                    uint32_t * addresses, match * pending, size_t & batched) const;
+        void _flush(uint32_t * addresses, match * pending, size_t & batched, piece_result & result) const;
+        void _scan_piece(std::string_view text, uint64_t offset, piece_result & result) const;
+
+        // scans one block of whole lines and appends its matches to out
+        void _scan_block(std::string_view block, uint64_t offset, std::string_view name, std::string & out);
+
+    public:
+        /**
+            @param filter the filter to check tokens against; it must outlive the scanner.
+            @param threads how many threads scan, the calling one included; 0 means one per core.
+        **/
+        explicit log_scanner(const malicious_url_filter & filter, size_t threads = 0);
+
+        /**
+            @brief Scans the file at path ("-" for standard input) and writes its matches to out.
+
+            @param path the file to read.
+            @param out where match lines go (a FILE, so large writes skip stream formatting).
+            @return false if the file could not be opened or read.
+        **/
+        bool scan(std::string const & path, FILE * out);
+
+        /**
+            @brief Returns what has been scanned so far, over every call to scan().
+        **/
+        const totals & scanned() const noexcept { return this->_totals; }
+};
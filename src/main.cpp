@@ -1,9 +1,87 @@
+#ifdef MALICIOUS_FILTER_EMBEDDED
+#include "embedded_filter.h"
+#else
+#include "log_scanner.h"
 #include "malicious_url_filter.h"
+#endif
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
 #include <string>
+#include <vector>
+
+#ifndef MALICIOUS_FILTER_EMBEDDED
+/*
+    malicious_filter scan [-b block_list] [-p patterns] [-t threads] [file ...]
+
+    Writes every match in the files (standard input if none, or "-") as
+    name:line:offset:kind:token, and a summary with the scan rate to stderr.
+    Exits 0 if anything matched, 1 if nothing did, and 2 on an error, like grep.
+*/
+static int scan(int argc, char ** argv) {
+
+    std::string block_list = "resources/block.txt", patterns = "resources/patterns.txt";
+    bool patterns_given = false;
+    size_t threads = 0;
+    std::vector<std::string> files;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if ((arg == "-b" || arg == "-p" || arg == "-t") && i + 1 < argc) {
+            std::string value = argv[++i];
+            if (arg == "-b") block_list = value;
+            else if (arg == "-p") patterns = value, patterns_given = true;
+            else threads = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            std::cerr << "usage: " << argv[0] << " scan [-b block_list] [-p patterns] [-t threads] [file ...]\n";
+            return 2;
+        } else {
+            files.push_back(arg);
+        }
+    }
+    if (files.empty()) files.push_back("-");
+
+    // the filter loads a missing file as an empty list, which would only ever report "no matches"
+    if (!std::ifstream(block_list).good()) {
+        std::cerr << argv[0] << ": " << block_list << ": cannot read block list\n";
+        return 2;
+    }
+    if (patterns_given && !std::ifstream(patterns).good()) {
+        std::cerr << argv[0] << ": " << patterns << ": cannot read patterns\n";
+        return 2;
+    }
+
+    malicious_url_filter filter(block_list, patterns, threads);
+    log_scanner scanner(filter, threads);
+
+    bool failed = false;
+    for (const std::string & file : files) {
+        if (!scanner.scan(file, stdout)) {
+            std::cerr << argv[0] << ": " << file << ": cannot read\n";
+            failed = true;
+        }
+    }
+    std::fflush(stdout);
+
+    const log_scanner::totals & totals = scanner.scanned();
+    std::fprintf(stderr, "scanned %llu bytes, %llu lines, %llu tokens: %llu matches in %.3f s (%.2f GB/s)\n",
+                 static_cast<unsigned long long>(totals.bytes), static_cast<unsigned long long>(totals.lines),
+                 static_cast<unsigned long long>(totals.tokens), static_cast<unsigned long long>(totals.matches),
+                 totals.seconds, totals.seconds > 0 ? static_cast<double>(totals.bytes) / totals.seconds / 1e9 : 0.0);
+    return failed ? 2 : totals.matches > 0 ? 0 : 1;
+
+}
+#endif
+
+int main(int argc, char ** argv) {
+#ifdef MALICIOUS_FILTER_EMBEDDED
+    // the list was compiled in by tools/generate_perfect_hash.cpp
+    embedded_filter filter;
+#else
+    if (argc > 1 && std::string(argv[1]) == "scan") return scan(argc, argv);
 
-int main() {
     malicious_url_filter filter = malicious_url_filter();
+#endif
 
     // find the IP in the hash map
     std::string IP{"2.57.149.0/24"};
@@ -12,6 +90,40 @@ int main() {
     else
         std::cout << IP << " not found. This URL is safe.\n";
     
+    // check a single client address against the blocked ranges
+    std::string client{"2.57.149.17"};
+    if (filter.is_Malicious_IP(client))
+        std::cout << client << " is in a blocked range. This IP is malicious.\n";
+    else
+        std::cout << client << " is not in a blocked range. This IP is safe.\n";
+
+    // match a URL by its host; an address host is checked against the ranges
+    std::string url{"http://2.57.149.17/index.html"};
+    if (filter.is_Malicious_Domain(url))
+        std::cout << url << " has a blocked host. This URL is malicious.\n";
+    else
+        std::cout << url << " has no blocked host. This URL is safe.\n";
+
+#ifdef MALICIOUS_FILTER_EMBEDDED
+    std::cout << "Embedded entries: " << filter.prefix_count() << " CIDR, " << filter.ipv6_prefix_count() << " IPv6 CIDR, "
+              << filter.key_count() << " other\n";
+#else
+    // look for blocked substrings anywhere in a URL
+    std::string request{"http://example.com/wp-login.php?action=register"};
+    if (filter.is_Malicious_Pattern(request))
+        std::cout << request << " contains a blocked pattern. This URL is malicious.\n";
+    else
+        std::cout << request << " contains no blocked pattern. This URL is safe.\n";
+
     std::cout << "Load factor: " << filter.load_factor() << "\n";
+    std::cout << "CIDR entries: " << filter.prefix_count() << " (" << filter.prefix_memory() << " bytes)\n";
+    std::cout << "Ranges after aggregation: " << filter.range_count() << " (" << filter.aggregated_count() << " removed)\n";
+    std::cout << "Prefilter: " << filter.prefilter_memory() << " bytes, false positive rate "
+              << filter.prefilter_false_positive_rate() << "\n";
+    std::cout << "URL patterns: " << filter.pattern_count() << " (" << filter.pattern_memory() << " bytes)\n";
+#ifdef MALICIOUS_FILTER_STATS
+    std::cout << filter.stats().to_text();
+#endif
+#endif
 
 }
\ No newline at end of file
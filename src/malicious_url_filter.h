@@ -1,68 +1,717 @@
+#pragma once
+
+#include "aho_corasick.h"
+#include "arena.h"
+#include "bloom_filter.h"
+#include "filter_delta.h"
+#include "filter_stats.h"
 #include "hash_functions.h"
 #include "UnorderedMap.h"
+#include "FlatUnorderedMap.h"
+#include "ipv4.h"
+#include "ipv4_lpm.h"
+#include "ipv4_prefix_set.h"
+#include "ipv6.h"
+#include "ipv6_lpm.h"
+#include "mapped_file.h"
+#include "parallel.h"
+#include "snapshot.h"
+#include "url.h"
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <fstream>
+#include <iterator>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
+
+// keys are views of bytes copied into the filter's arena, and nodes come from the same arena
+using MapAllocator = arena_allocator<std::pair<const std::string_view,int>>;
+
+// build with -DMALICIOUS_FILTER_FLAT_MAP to use the open-addressing table
+#ifdef MALICIOUS_FILTER_FLAT_MAP
+using HashMapType = FlatUnorderedMap<std::string_view,int,fnv1a_hash,std::equal_to<>,MapAllocator>;
+#else
+using HashMapType = UnorderedMap<std::string_view,int,fnv1a_hash,std::equal_to<>,prime_fastmod_range,MapAllocator>;
+#endif
+using value_type = std::pair<std::string_view,int>;
+
+/**
+ * ## Block List Text
+ * @brief A block list and its URL patterns, read into memory whole.
+ */
+struct block_list_text {
+    std::string entries {};
+    std::string patterns {};
+};
+
+/**
+    @brief Reads the block list at path and the patterns at patterns_path into out.
 
-using HashMapType = UnorderedMap<std::string,int,fnv1a_hash>;
-using value_type = std::pair<std::string,int>;
+    @return false if the block list cannot be read; a missing patterns file means none.
+**/
+inline bool read_block_list(std::string const & path, std::string const & patterns_path, block_list_text & out) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    out.entries.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    if (file.bad()) return false;
+    std::ifstream pattern_file(patterns_path, std::ios::binary);
+    out.patterns.assign(std::istreambuf_iterator<char>(pattern_file), std::istreambuf_iterator<char>());
+    return true;
+}
 
 /**
  * ## Malicious URL Filter
  * @brief This class is designed to filter given IP addresses using a hash map for O(1) time.
+ *
+ * CIDR entries are parsed once and kept as packed integers (four bytes each in
+ * a sorted per-length array, plus the longest-prefix-match table for address
+ * lookups). IPv6 CIDR entries get the same treatment in a sorted array and
+ * their own trie. Only entries that are not prefixes go into the string map.
  */
 class malicious_url_filter {
     private:
+        // owns every map node and key byte; held by pointer so moving the filter keeps the map's allocator valid
+        std::unique_ptr<arena> storage;
         HashMapType map;
+        // the lowercased form of each bare host listed in another spelling, seen only by domain lookups,
+        // with how many listed spellings lower to it
+        HashMapType hosts;
+        ipv4_lpm prefixes;
+        ipv4_prefix_set networks;
+        size_t aggregated;
+        ipv6_lpm prefixes6;
+        std::vector<ipv6_prefix> networks6;   // sorted, for exact lookups
+
+        // every entry's key, so most clean lookups stop after one cache line
+        blocked_bloom_filter prefilter;
+
+        // substrings that make any URL containing them malicious
+        aho_corasick patterns;
+
+        // lookup counts, when built with MALICIOUS_FILTER_STATS; otherwise empty
+        lookup_counters counters;
+        double load_seconds;
+
+        // see generation() and sequence()
+        uint64_t version;
+        uint64_t sequence_number;
+
+        static uint64_t next_generation() {
+            static std::atomic<uint64_t> next { 1 };
+            return next.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        static uint64_t prefilter_key(const ipv4_prefix & prefix) {
+            return hash_mix((static_cast<uint64_t>(prefix.network) << 8) | prefix.length, UINT64_C(0x9E3779B97F4A7C15));
+        }
+
+        static uint64_t prefilter_key(const ipv6_prefix & prefix) {
+            return hash_mix(prefix.network.high ^ hash_mix(prefix.network.low, prefix.length), UINT64_C(0x9E3779B97F4A7C15));
+        }
+
+        static uint64_t prefilter_key(std::string_view entry) { return wy_hash()(entry); }
+
+        // a bare host name (no scheme, port or path) lowercased into buffer, for the domain lookups
+        static bool normalized_host(std::string_view line, char * buffer, std::string_view & host) {
+            return extract_url_host(line, buffer, host) && host.size() == line.size() - (line.back() == '.') && host.front() != '[';
+        }
+
+        bool contains_prefix(const ipv6_prefix & prefix) const {
+            return this->prefilter.may_contain(prefilter_key(prefix))
+                && std::binary_search(this->networks6.begin(), this->networks6.end(), prefix);
+        }
+
+        // the longest listed prefix strictly enclosing prefix, or -1
+        int covering_length(const ipv4_prefix & prefix) const {
+            for (int length = prefix.length - 1; length >= 0; --length) {
+                uint8_t l = static_cast<uint8_t>(length);
+                if ((this->networks.lengths() >> l & 1) && this->networks.contains(ipv4_prefix { prefix.network & ipv4_mask(l), l }))
+                    return length;
+            }
+            return -1;
+        }
+
+        int covering_length(const ipv6_prefix & prefix) const {
+            for (int length = prefix.length - 1; length >= 0; --length) {
+                uint8_t l = static_cast<uint8_t>(length);
+                if (std::binary_search(this->networks6.begin(), this->networks6.end(), ipv6_prefix { ipv6_mask(prefix.network, l), l }))
+                    return length;
+            }
+            return -1;
+        }
+
+        // builds every table from the list and pattern text; the constructors' shared body
+        void load(std::string_view text, std::string_view pattern_text, size_t threads) {
+
+            // the maps grow incrementally as entries are added, targeting a ~0.75 load factor
+            map.max_load_factor(0.75f);
+            hosts.max_load_factor(0.75f);
+
+            // give each worker about a megabyte of whole lines
+            std::vector<std::string_view> pieces = split_lines(text, parallel_threads(threads, text.size(), 1u << 20));
+            if (pieces.empty()) pieces.push_back(std::string_view());
+
+            struct loaded_piece {
+                std::vector<ipv4_prefix> parsed {};
+                std::vector<ipv6_prefix> parsed6 {};
+                std::vector<std::string_view> others {};
+                std::vector<size_t> renamed {};    // others whose normalized host is spelled differently
+                std::vector<uint64_t> keys {};     // prefilter keys of all of the above
+            };
+            std::vector<loaded_piece> loaded(pieces.size());
+
+            parallel_for(pieces.size(), [&pieces, &loaded](size_t t) {
+                loaded_piece & piece = loaded[t];
+
+                // CIDR entries go to the prefix tables, and everything else to the hash map
+                parse_ipv4_cidr_lines(pieces[t], piece.parsed, piece.others);
+
+                // IPv6 CIDR entries leave the others too
+                size_t kept = 0;
+                for (std::string_view line : piece.others) {
+                    ipv6_prefix prefix;
+                    if (parse_ipv6_cidr(line, prefix)) piece.parsed6.push_back(prefix);
+                    else piece.others[kept++] = line;
+                }
+                piece.others.resize(kept);
+
+                // the prefilter sees every entry exactly as the lookups will, bare hosts also normalized
+                piece.keys.reserve(piece.parsed.size() + piece.parsed6.size() + piece.others.size());
+                for (const ipv4_prefix & prefix : piece.parsed) piece.keys.push_back(prefilter_key(prefix));
+                for (const ipv6_prefix & prefix : piece.parsed6) piece.keys.push_back(prefilter_key(prefix));
+                char buffer[URL_HOST_MAX];
+                for (size_t i = 0; i < piece.others.size(); ++i) {
+                    std::string_view line = piece.others[i], host;
+                    piece.keys.push_back(prefilter_key(line));
+                    if (normalized_host(line, buffer, host) && host != line) {
+                        piece.renamed.push_back(i);
+                        piece.keys.push_back(prefilter_key(host));
+                    }
+                }
+
+                // sorted runs, merged below, so aggregation needs no sort of its own
+                std::sort(piece.parsed.begin(), piece.parsed.end());
+            });
+
+            std::vector<ipv4_prefix> parsed;
+            std::vector<size_t> runs(1, 0);
+            std::vector<uint64_t> keys;
+            size_t entries = 0;
+            for (loaded_piece & piece : loaded) {
+                parsed.insert(parsed.end(), piece.parsed.begin(), piece.parsed.end());
+                runs.push_back(parsed.size());
+                networks6.insert(networks6.end(), piece.parsed6.begin(), piece.parsed6.end());
+                keys.insert(keys.end(), piece.keys.begin(), piece.keys.end());
+                entries += piece.parsed.size() + piece.parsed6.size() + piece.others.size() + piece.renamed.size();
+                std::vector<uint64_t>().swap(piece.keys);
+            }
+
+            prefilter = blocked_bloom_filter(entries);
+            prefilter.insert_parallel(keys.data(), keys.size(), threads);
+            std::vector<uint64_t>().swap(keys);
+
+            // exact lookups need every entry as written; address lookups only the ranges they cover
+            for (const ipv4_prefix & prefix : parsed) networks.insert(prefix);
+            networks.build(threads);
+            parallel_merge(parsed, runs, threads);
+            aggregated = aggregate_ipv4_prefixes(parsed);
+            prefixes.insert_parallel(parsed.data(), parsed.size(), threads);
+
+            for (const ipv6_prefix & prefix : networks6) prefixes6.insert(prefix);
+            std::sort(networks6.begin(), networks6.end());
+            networks6.erase(std::unique(networks6.begin(), networks6.end()), networks6.end());
+            networks6.shrink_to_fit();
+
+            // copy the keys out of the mapping in list order, so a repeated entry keeps its first line number;
+            // lowercased hosts go to their own map, so exact lookups never see them
+            std::vector<value_type> values;
+            std::vector<std::pair<std::string_view, std::string_view>> spellings;   // lowercased host, entry
+            int i = 1;
+            char buffer[URL_HOST_MAX];
+            for (const loaded_piece & piece : loaded) {
+                size_t next = 0;
+                for (size_t j = 0; j < piece.others.size(); ++j, ++i) {
+                    values.push_back(value_type(storage->store(piece.others[j]), i));
+                    std::string_view host;
+                    if (next < piece.renamed.size() && piece.renamed[next] == j && normalized_host(piece.others[j], buffer, host)) {
+                        spellings.push_back(std::make_pair(storage->store(host), piece.others[j]));
+                        ++next;
+                    }
+                }
+            }
+            map.insert_bulk(values.data(), values.size(), threads);
+
+            // each host counts its distinct spellings, so apply_delta drops it only with the last of them
+            std::sort(spellings.begin(), spellings.end());
+            spellings.erase(std::unique(spellings.begin(), spellings.end()), spellings.end());
+            std::vector<value_type> lowered;
+            for (const std::pair<std::string_view, std::string_view> & spelling : spellings) {
+                if (!lowered.empty() && lowered.back().first == spelling.first) ++lowered.back().second;
+                else lowered.push_back(value_type(spelling.first, 1));
+            }
+            hosts.insert_bulk(lowered.data(), lowered.size(), threads);
+
+            // one pattern per line, as std::getline would split them
+            size_t start = 0;
+            while (start < pattern_text.size()) {
+                size_t newline = pattern_text.find('\n', start);
+                if (newline == std::string_view::npos) newline = pattern_text.size();
+                std::string_view pattern = pattern_text.substr(start, newline - start);
+                start = newline + 1;
+                if (!pattern.empty() && pattern.back() == '\r') pattern.remove_suffix(1);
+                patterns.insert(pattern);
+            }
+            patterns.build();
+
+        }
 
     public:
         /** 
             ## Malicious URL Filter Constructor
             @brief Creates a malicious_url_filter object. 
+
+            The list is mapped into memory and split at line boundaries. Parsing,
+            hashing, sorting, and building the prefix table, the prefilter and the
+            string map all run on the worker threads.
+
+            @param path the block list to load, one entry per line.
+            @param patterns_path the URL substrings to block, one per line; a missing file means none.
+            @param threads how many threads may load the list, the calling one included; 0 means one per core.
         **/
-        malicious_url_filter() : map(1) {
+        explicit malicious_url_filter(std::string const & path = "resources/block.txt",
+                                      std::string const & patterns_path = "resources/patterns.txt",
+                                      size_t threads = 0) : storage(std::make_unique<arena>()),
+            map(1, fnv1a_hash { }, std::equal_to<> { }, MapAllocator(storage.get())),
+            hosts(1, fnv1a_hash { }, std::equal_to<> { }, MapAllocator(storage.get())), prefixes(), networks(), aggregated(0),
+            prefixes6(), networks6(), prefilter(),
+            patterns(true), counters(), load_seconds(0.0), version(next_generation()), sequence_number(0) {
 
-            // count how many lines there are
-            int line_count = 0;
-            std::string line;
-            std::ifstream file("resources/block.txt");
-            while (std::getline(file, line)) line_count++;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-            // create the hash map based on the number of lines
-            int bucket_count = line_count / 0.75;
-            map = HashMapType(bucket_count);
+            // map the whole list; the patterns are short enough to read
+            mapped_file file(path);
+            std::ifstream pattern_file(patterns_path, std::ios::binary);
+            std::string pattern_text((std::istreambuf_iterator<char>(pattern_file)), std::istreambuf_iterator<char>());
+            this->load(file.text(), pattern_text, threads);
 
-            // add all the blocked IPs to the hash map
-            file = std::ifstream("resources/block.txt");
-            line.clear();
-            int i = 1;
-            while (std::getline(file,line)) {
-                map.insert(value_type(line,i));
-                line.clear();
-                ++i;
-            }
+            load_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        }
+
+        /**
+            @brief Creates a malicious_url_filter from a block list already read into memory,
+            so several filters can be built from exactly the same content.
+
+            @param text the list and its patterns; the filter keeps copies of what it needs.
+            @param threads how many threads may load the list, the calling one included; 0 means one per core.
+        **/
+        explicit malicious_url_filter(const block_list_text & text, size_t threads = 0) : storage(std::make_unique<arena>()),
+            map(1, fnv1a_hash { }, std::equal_to<> { }, MapAllocator(storage.get())),
+            hosts(1, fnv1a_hash { }, std::equal_to<> { }, MapAllocator(storage.get())), prefixes(), networks(), aggregated(0),
+            prefixes6(), networks6(), prefilter(),
+            patterns(true), counters(), load_seconds(0.0), version(next_generation()), sequence_number(0) {
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            this->load(text.entries, text.patterns, threads);
+            load_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
         }
 
 
         /**
             @brief Determines if IP is a malicious URL.
+            CIDR text is compared as a prefix, so host bits past the length do not matter.
 
             @param IP the IP address that is to be checked.
         **/
-        bool is_Malicious_URL(std::string IP) {
-            auto find_IP = this->map.find(IP);
-            if (find_IP != HashMapType::iterator()) 
-                return true;
-            return false;
+        bool is_Malicious_URL(std::string_view IP) const {
+            return this->counters.count([this, IP] {
+                ipv4_prefix prefix;
+                if (parse_ipv4_cidr(IP, prefix))
+                    return this->prefilter.may_contain(prefilter_key(prefix)) && this->networks.contains(prefix);
+                ipv6_prefix prefix6;
+                if (parse_ipv6_cidr(IP, prefix6)) return this->contains_prefix(prefix6);
+                return this->prefilter.may_contain(prefilter_key(IP)) && this->map.contains(IP);
+            });
         }
 
         /**
-         * @brief Returns the load factor of the hash map.
-         * 
-         * 
+            @brief Determines if the host of url is a blocked domain or lies under one,
+            so a "evil.com" entry matches "http://a.b.evil.com/path?x=1".
+            An IPv4 or bracketed IPv6 host is checked against the blocked ranges instead.
+
+            @param url a URL, or just a host name; letter case does not matter.
+        **/
+        bool is_Malicious_Domain(std::string_view url) const {
+            return this->counters.count([this, url] {
+                char buffer[URL_HOST_MAX];
+                std::string_view host;
+                if (!extract_url_host(url, buffer, host)) return false;
+
+                uint32_t address;
+                if (parse_ipv4(host, address)) return this->prefixes.contains(address);
+                ipv6_address address6;
+                if (host.front() == '[')
+                    return parse_ipv6(host.substr(1, host.size() - 2), address6) && this->prefixes6.contains(address6);
+
+                // the host itself, then each parent domain
+                do {
+                    if (this->prefilter.may_contain(prefilter_key(host)) && (this->map.contains(host) || this->hosts.contains(host))) return true;
+                } while (parent_domain(host));
+                return false;
+            });
+        }
+
+        /**
+            @brief Determines if url contains any blocked pattern, ignoring ASCII case.
+            The whole URL is scanned once, however many patterns there are.
+        **/
+        bool is_Malicious_Pattern(std::string_view url) const {
+            return this->counters.count([this, url] { return this->patterns.contains(url); });
+        }
+
+        /**
+            @brief Determines, for each of count entries, whether it is a malicious URL.
+            Equivalent to calling is_Malicious_URL on each, but overlaps the memory stalls.
+
+            @param IPs the entries that are to be checked.
+            @param count the number of entries.
+            @param out receives one result per entry.
+        **/
+        void is_Malicious_batch(const std::string_view * IPs, size_t count, bool * out) const {
+            std::string_view keys[64];
+            size_t positions[64];
+            HashMapType::const_iterator found[64];
+            for (size_t base = 0; base < count; base += 64) {
+                size_t n = count - base < 64 ? count - base : 64;
+
+                // answer CIDR text and prefilter misses directly, and gather the rest for one batched map lookup
+                size_t deferred = 0;
+                ipv4_prefix prefix;
+                ipv6_prefix prefix6;
+                for (size_t i = 0; i < n; ++i) {
+                    if (parse_ipv4_cidr(IPs[base + i], prefix)) {
+                        out[base + i] = this->prefilter.may_contain(prefilter_key(prefix)) && this->networks.contains(prefix);
+                    } else if (parse_ipv6_cidr(IPs[base + i], prefix6)) {
+                        out[base + i] = this->contains_prefix(prefix6);
+                    } else if (!this->prefilter.may_contain(prefilter_key(IPs[base + i]))) {
+                        out[base + i] = false;
+                    } else {
+                        keys[deferred] = IPs[base + i];
+                        positions[deferred++] = base + i;
+                    }
+                }
+
+                this->map.find_batch(keys, deferred, found);
+                for (size_t i = 0; i < deferred; ++i) out[positions[i]] = found[i] != this->map.cend();
+
+#ifdef MALICIOUS_FILTER_STATS
+                size_t hits = 0;
+                for (size_t i = 0; i < n; ++i) hits += out[base + i];
+                this->counters.count_batch(n, hits);
+#endif
+            }
+        }
+
+        /**
+            @brief Determines if IP falls inside any blocked CIDR range.
+
+            @param IP the address in host byte order.
+        **/
+        bool is_Malicious_IP(uint32_t IP) const {
+            return this->counters.count([this, IP] { return this->prefixes.contains(IP); });
+        }
+
+        /**
+            @brief Determines if IP falls inside any blocked CIDR range.
+
+            @param IP an IPv6 address.
+        **/
+        bool is_Malicious_IP(const ipv6_address & IP) const {
+            return this->counters.count([this, &IP] { return this->prefixes6.contains(IP); });
+        }
+
+        /**
+            @brief Determines if IP falls inside any blocked CIDR range.
+
+            @param IP an IPv4 dotted quad or an IPv6 address in any text form. Malformed input is never malicious.
+        **/
+        bool is_Malicious_IP(std::string_view IP) const {
+            return this->counters.count([this, IP] {
+                uint32_t address;
+                if (parse_ipv4(IP, address)) return this->prefixes.contains(address);
+                ipv6_address address6;
+                return parse_ipv6(IP, address6) && this->prefixes6.contains(address6);
+            });
+        }
+
+        /**
+            @brief Determines, for each of count addresses, whether it falls inside a blocked range.
+
+            @param IPs the addresses in host byte order.
+            @param count the number of addresses.
+            @param out receives one result per address.
+        **/
+        void is_Malicious_IP_batch(const uint32_t * IPs, size_t count, bool * out) const {
+            this->prefixes.contains_batch(IPs, count, out);
+#ifdef MALICIOUS_FILTER_STATS
+            size_t hits = 0;
+            for (size_t i = 0; i < count; ++i) hits += out[i];
+            this->counters.count_batch(count, hits);
+#endif
+        }
+
+        /**
+            @brief Applies a batch of additions and removals in place. Lookups must not run
+            meanwhile; reloadable_filter::apply_delta updates a filter that is serving.
+
+            Map inserts and erases and the prefix table updates cost in proportion to the delta.
+            The exact CIDR sets do not: they are plain sorted arrays, so every IPv4 prefix length
+            the delta touches is merged again whole, and so is the IPv6 array if any IPv6 entry
+            changes. One changed line in a list of a million /32s therefore still copies four
+            megabytes (sixteen bytes per entry for IPv6). A side buffer merged later would make
+            this proportional to the delta too, at the price of a second search on every exact
+            CIDR lookup; until a list makes that worth it, deltas pay the copy.
+
+            Removed keys keep their arena bytes, and the prefilter keeps their bits (a stale bit
+            only costs an exact lookup), until the list is loaded again. A lowercased host stays
+            while any listed spelling of it does.
+
+            @param delta the changes, numbered past those applied so far.
+            @return false, changing nothing, if delta.sequence is not past sequence().
+        **/
+        bool apply_delta(const filter_delta & delta) {
+
+            if (delta.sequence <= this->sequence_number) return false;
+
+            // sort the changes as loading does: IPv4 CIDR, IPv6 CIDR, and everything else
+            std::vector<ipv4_prefix> added, removed;
+            std::vector<ipv6_prefix> added6, removed6;
+            std::vector<std::string_view> added_others, removed_others;
+            auto classify = [](std::string_view line, std::vector<ipv4_prefix> & v4, std::vector<ipv6_prefix> & v6,
+                               std::vector<std::string_view> & others) {
+                ipv4_prefix prefix;
+                ipv6_prefix prefix6;
+                if (parse_ipv4_cidr(line, prefix)) v4.push_back(prefix);
+                else if (parse_ipv6_cidr(line, prefix6)) v6.push_back(prefix6);
+                else others.push_back(line);
+            };
+            for (const std::string & line : delta.added) classify(line, added, added6, added_others);
+            for (const std::string & line : delta.removed) classify(line, removed, removed6, removed_others);
+
+            // only prefixes that really come or go reach the tables, each once ("1.2.3.4" and "1.2.3.4/32" are one)
+            auto same = [](const ipv4_prefix & a, const ipv4_prefix & b) { return a.network == b.network && a.length == b.length; };
+            std::sort(added.begin(), added.end());
+            added.erase(std::unique(added.begin(), added.end(), same), added.end());
+            added.erase(std::remove_if(added.begin(), added.end(), [this](const ipv4_prefix & p) { return this->networks.contains(p); }), added.end());
+            std::sort(removed.begin(), removed.end());
+            removed.erase(std::unique(removed.begin(), removed.end(), same), removed.end());
+            removed.erase(std::remove_if(removed.begin(), removed.end(), [this](const ipv4_prefix & p) { return !this->networks.contains(p); }), removed.end());
+            this->networks.update(added, removed);
+
+            // a removed prefix's addresses go back to whatever listed prefixes still cover them
+            std::vector<ipv4_prefix> inside;
+            for (const ipv4_prefix & prefix : removed) {
+                inside.clear();
+                uint64_t last = static_cast<uint64_t>(prefix.network) + (uint64_t(1) << (32 - prefix.length)) - 1;
+                for (uint8_t length = static_cast<uint8_t>(prefix.length + 1); length <= 32; ++length) {
+                    if (!(this->networks.lengths() >> length & 1)) continue;
+                    const std::vector<uint32_t> & listed = this->networks.networks(length);
+                    for (auto it = std::lower_bound(listed.begin(), listed.end(), prefix.network); it != listed.end() && *it <= last; ++it)
+                        inside.push_back(ipv4_prefix { *it, length });
+                }
+                this->prefixes.remove(prefix.network, prefix.length, this->covering_length(prefix), inside.data(), inside.size());
+            }
+            for (const ipv4_prefix & prefix : added) {
+                this->prefixes.insert(prefix);
+                this->prefilter.insert(prefilter_key(prefix));
+            }
+
+            // the same for IPv6, whose exact set is one sorted array
+            std::sort(added6.begin(), added6.end());
+            added6.erase(std::unique(added6.begin(), added6.end()), added6.end());
+            added6.erase(std::remove_if(added6.begin(), added6.end(), [this](const ipv6_prefix & p) {
+                return std::binary_search(this->networks6.begin(), this->networks6.end(), p);
+            }), added6.end());
+            std::sort(removed6.begin(), removed6.end());
+            removed6.erase(std::unique(removed6.begin(), removed6.end()), removed6.end());
+            removed6.erase(std::remove_if(removed6.begin(), removed6.end(), [this](const ipv6_prefix & p) {
+                return !std::binary_search(this->networks6.begin(), this->networks6.end(), p);
+            }), removed6.end());
+            if (!added6.empty() || !removed6.empty()) {
+                std::vector<ipv6_prefix> kept, merged;
+                std::set_difference(this->networks6.begin(), this->networks6.end(), removed6.begin(), removed6.end(), std::back_inserter(kept));
+                std::set_union(kept.begin(), kept.end(), added6.begin(), added6.end(), std::back_inserter(merged));
+                this->networks6.swap(merged);
+            }
+
+            std::vector<ipv6_prefix> inside6;
+            for (const ipv6_prefix & prefix : removed6) {
+                // sorted by network, the prefixes inside this one follow it
+                inside6.clear();
+                for (auto it = std::upper_bound(this->networks6.begin(), this->networks6.end(), prefix);
+                     it != this->networks6.end() && ipv6_mask(it->network, prefix.length) == prefix.network; ++it)
+                    if (it->length > prefix.length) inside6.push_back(*it);
+                this->prefixes6.remove(prefix, this->covering_length(prefix), inside6.data(), inside6.size());
+            }
+            for (const ipv6_prefix & prefix : added6) {
+                this->prefixes6.insert(prefix);
+                this->prefilter.insert(prefilter_key(prefix));
+            }
+
+            // other entries, with the lowercased host that loading adds for a bare host name
+            char buffer[URL_HOST_MAX];
+            std::string_view host;
+            for (std::string_view line : removed_others) {
+                // only a line really listed counts against its host
+                if (this->map.erase(line) == 0 || !normalized_host(line, buffer, host) || host == line) continue;
+                HashMapType::iterator found = this->hosts.find(host);
+                if (found != this->hosts.end() && --found->second <= 0) this->hosts.erase(found);
+            }
+            for (std::string_view line : added_others) {
+                if (this->map.contains(line)) continue;
+                this->map.insert(HashMapType::value_type(this->storage->store(line), 0));
+                this->prefilter.insert(prefilter_key(line));
+                if (!normalized_host(line, buffer, host) || host == line) continue;
+                HashMapType::iterator found = this->hosts.find(host);
+                if (found != this->hosts.end()) {
+                    ++found->second;
+                } else {
+                    this->hosts.insert(HashMapType::value_type(this->storage->store(host), 1));
+                    this->prefilter.insert(prefilter_key(host));
+                }
+            }
+
+            this->sequence_number = delta.sequence;
+            this->version = next_generation();
+            return true;
+
+        }
+
+        /**
+            @brief Reads the delta file at path and applies it.
+
+            @return false if the file cannot be read or parsed, or its sequence number is not past sequence().
+        **/
+        bool apply_delta(std::string const & path) {
+            filter_delta delta;
+            return read_filter_delta(path, delta) && this->apply_delta(delta);
+        }
+
+        /**
+         * @brief Returns the sequence number of the last delta applied, or 0 if none has been.
+         */
+        uint64_t sequence() const noexcept { return this->sequence_number; }
+
+        /**
+            @brief Writes the built index to a snapshot that mapped_filter can serve from.
+
+            @param path the snapshot file to (over)write.
+            @return true if the whole file was written and moved into place; see ::write_snapshot.
+        **/
+        bool write_snapshot(std::string const & path) const {
+            std::vector<std::string_view> keys, lowered;
+            keys.reserve(this->map.size());
+            for (auto it = this->map.cbegin(); it != this->map.cend(); ++it) keys.push_back(it->first);
+            lowered.reserve(this->hosts.size());
+            for (auto it = this->hosts.cbegin(); it != this->hosts.cend(); ++it) lowered.push_back(it->first);
+            return ::write_snapshot(path, this->prefixes, this->networks, this->networks6, keys, lowered);
+        }
+
+        /**
+         * @brief Returns the load factor of the hash map of listed entries; the lowercased
+         * hosts kept for domain lookups are in a map of their own.
          */
         float load_factor() const { return this->map.load_factor(); }
 
+        /**
+         * @brief Returns the number of distinct CIDR entries.
+         */
+        size_t prefix_count() const { return this->networks.size(); }
+
+        /**
+         * @brief Returns the bytes held by the packed CIDR entries.
+         */
+        size_t prefix_memory() const { return this->networks.memory_usage(); }
+
+        /**
+         * @brief Returns the number of CIDR entries that aggregation removed before building the prefix table
+         * (duplicates, prefixes covered by shorter ones, and merged siblings).
+         */
+        size_t aggregated_count() const { return this->aggregated; }
+
+        /**
+         * @brief Returns the number of ranges in the prefix table after aggregation.
+         * Deltas are not aggregated: each added prefix counts one more, and each removed one less.
+         */
+        size_t range_count() const { return this->prefixes.size(); }
+
+        /**
+         * @brief Returns the bytes held by the prefilter.
+         */
+        size_t prefilter_memory() const { return this->prefilter.memory_usage(); }
+
+        /**
+         * @brief Returns the chance that a clean entry gets past the prefilter to the exact lookup.
+         */
+        double prefilter_false_positive_rate() const { return this->prefilter.false_positive_rate(); }
+
+        /**
+         * @brief Returns the number of distinct IPv6 CIDR entries.
+         */
+        size_t ipv6_prefix_count() const { return this->networks6.size(); }
+
+        /**
+         * @brief Returns the bytes held by the IPv6 entries and their prefix table.
+         */
+        size_t ipv6_prefix_memory() const {
+            return this->networks6.capacity() * sizeof(ipv6_prefix) + this->prefixes6.memory_usage();
+        }
+
+        /**
+         * @brief Returns the number of URL patterns loaded.
+         */
+        size_t pattern_count() const { return this->patterns.size(); }
+
+        /**
+         * @brief Returns the bytes held by the pattern automaton.
+         */
+        size_t pattern_memory() const { return this->patterns.memory_usage(); }
+
+        /**
+         * @brief Returns a number that identifies what this filter blocks. No two filters
+         * in the process share one, so a cached answer tagged with it can never be
+         * mistaken for another filter's, or for this one's after its contents change.
+         */
+        uint64_t generation() const noexcept { return this->version; }
+
+        /**
+         * @brief Adds this filter's lookup counts (with -DMALICIOUS_FILTER_STATS) into stats,
+         * without walking the map as stats() does.
+         */
+        void add_lookup_counts(filter_stats & stats) const { this->counters.read(stats); }
+
+        /**
+         * @brief Returns the lookup counts (with -DMALICIOUS_FILTER_STATS), the hash map's
+         * layout, the memory held by each part and how long loading took.
+         * The map is walked on every call, so this is for monitoring, not the lookup path.
+         */
+        filter_stats stats() const {
+            filter_stats stats;
+            this->counters.read(stats);
+            stats.add_map(this->map);
+            stats.map_bytes = this->storage->bytes_reserved();
+            stats.prefix_bytes = this->prefix_memory() + this->prefixes.memory_usage();
+            stats.ipv6_bytes = this->ipv6_prefix_memory();
+            stats.prefilter_bytes = this->prefilter_memory();
+            stats.pattern_bytes = this->pattern_memory();
+            stats.load_seconds = this->load_seconds;
+            return stats;
+        }
+
 };
 
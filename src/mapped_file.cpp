@@ -0,0 +1,33 @@
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+mapped_file::mapped_file(std::string const & path) : _data(nullptr), _size(0) {
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return;
+    }
+
+    // private and read-only: the loader only reads, and every page is wanted soon
+    size_t size = static_cast<size_t>(st.st_size);
+    void * base = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) return;
+    ::madvise(base, size, MADV_WILLNEED);
+
+    this->_data = static_cast<const char*>(base);
+    this->_size = size;
+
+}
+
+mapped_file::~mapped_file() {
+    if (this->_data != nullptr) ::munmap(const_cast<char*>(this->_data), this->_size);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/**
+ * ## Mapped File
+ * @brief A whole file mapped read-only into memory, for parsing in place.
+ *
+ * The text stays valid until the object is destroyed. A file that cannot be
+ * opened or mapped, or is empty, reads as empty text.
+ */
+class mapped_file {
+    private:
+        const char * _data;
+        size_t _size;
+
+    public:
+        explicit mapped_file(std::string const & path);
+
+        ~mapped_file();
+
+        mapped_file(const mapped_file &) = delete;
+        mapped_file & operator=(const mapped_file &) = delete;
+
+        std::string_view text() const noexcept { return std::string_view(this->_data, this->_size); }
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/*
+    Runs body(t) for every t in [0, threads), each on its own thread, and
+    returns once all have finished. Part 0 runs on the calling thread, so
+    one thread costs no spawn at all.
+*/
+template <typename F>
+void parallel_for(size_t threads, F && body) {
+    std::vector<std::thread> workers;
+    workers.reserve(threads > 1 ? threads - 1 : 0);
+    for (size_t t = 1; t < threads; ++t) workers.emplace_back([&body, t] { body(t); });
+    body(0);
+    for (std::thread & worker : workers) worker.join();
+}
+
+/*
+    Returns how many threads to give work that splits into count items,
+    allowing at least per_thread items each: requested (0 means one per
+    core), but no more than the work can keep busy.
+*/
+inline size_t parallel_threads(size_t requested, size_t count, size_t per_thread) {
+    size_t threads = requested != 0 ? requested : std::thread::hardware_concurrency();
+    size_t useful = per_thread == 0 ? count : count / per_thread;
+    if (threads > useful) threads = useful;
+    return threads == 0 ? 1 : threads;
+}
+
+/*
+    Groups the items [0, count) by which of threads owners they go to, so
+    each owner walks only its own: owners(i) returns the range [first, last)
+    of owners that item i goes to. Fills starts (threads + 1 bounds) and
+    returns the item indices, owner by owner and in input order within each.
+    Counting and scattering both split the input across threads, so the
+    whole pass is O(count + threads * threads).
+*/
+template <typename F>
+std::vector<size_t> partition_by_owner(size_t count, size_t threads, F && owners, std::vector<size_t> & starts) {
+
+    // counts[t * threads + u] is how many items of thread t's slice go to owner u
+    std::vector<size_t> counts(threads * threads, 0);
+    parallel_for(threads, [&](size_t t) {
+        std::vector<size_t> local(threads, 0);
+        for (size_t i = count * t / threads; i < count * (t + 1) / threads; ++i) {
+            std::pair<size_t, size_t> range = owners(i);
+            for (size_t u = range.first; u < range.second; ++u) ++local[u];
+        }
+        std::copy(local.begin(), local.end(), counts.begin() + static_cast<ptrdiff_t>(t * threads));
+    });
+
+    // turn the counts into where each thread writes its items for each owner
+    size_t offset = 0;
+    starts.assign(threads + 1, 0);
+    for (size_t u = 0; u < threads; ++u) {
+        starts[u] = offset;
+        for (size_t t = 0; t < threads; ++t) {
+            size_t n = counts[t * threads + u];
+            counts[t * threads + u] = offset;
+            offset += n;
+        }
+    }
+    starts[threads] = offset;
+
+    std::vector<size_t> order(offset);
+    parallel_for(threads, [&](size_t t) {
+        std::vector<size_t> next(counts.begin() + static_cast<ptrdiff_t>(t * threads), counts.begin() + static_cast<ptrdiff_t>((t + 1) * threads));
+        for (size_t i = count * t / threads; i < count * (t + 1) / threads; ++i) {
+            std::pair<size_t, size_t> range = owners(i);
+            for (size_t u = range.first; u < range.second; ++u) order[next[u]++] = i;
+        }
+    });
+    return order;
+
+}
+
+/*
+    Splits text into parts pieces of about equal size, each ending just
+    after a newline (or at the end of text), so no line is cut in two.
+    Fewer pieces come back when the text has fewer lines than parts.
+*/
+inline std::vector<std::string_view> split_lines(std::string_view text, size_t parts) {
+    std::vector<std::string_view> pieces;
+    size_t start = 0;
+    for (size_t i = 1; i <= parts && start < text.size(); ++i) {
+        size_t end = i == parts ? text.size() : text.size() / parts * i;
+        if (end < start) end = start;
+        end = text.find('\n', end);
+        end = end == std::string_view::npos ? text.size() : end + 1;
+        pieces.push_back(text.substr(start, end - start));
+        start = end;
+    }
+    return pieces;
+}
+
+/*
+    Merges the sorted runs of items that start at each of bounds (which ends
+    with items.size()) into one sorted range, merging neighbouring pairs of
+    runs side by side until one is left.
+*/
+template <typename T>
+void parallel_merge(std::vector<T> & items, std::vector<size_t> bounds, size_t threads) {
+    while (bounds.size() > 2) {
+        size_t pairs = (bounds.size() - 1) / 2;
+        size_t workers = parallel_threads(threads, pairs, 1);
+        parallel_for(workers, [&items, &bounds, pairs, workers](size_t t) {
+            for (size_t p = t; p < pairs; p += workers) {
+                std::inplace_merge(items.begin() + static_cast<ptrdiff_t>(bounds[2 * p]),
+                                   items.begin() + static_cast<ptrdiff_t>(bounds[2 * p + 1]),
+                                   items.begin() + static_cast<ptrdiff_t>(bounds[2 * p + 2]));
+            }
+        });
+
+        // every other bound is left, and the end if the last run had no partner
+        std::vector<size_t> merged;
+        for (size_t b = 0; b < bounds.size(); b += 2) merged.push_back(bounds[b]);
+        if (merged.back() != bounds.back()) merged.push_back(bounds.back());
+        bounds.swap(merged);
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>      // size_t
+#include <cstdint>      // uint32_t, uint64_t
+#include <string_view>
+
+/*
+    Lookup side of the minimal perfect hash tables that
+    tools/generate_perfect_hash.cpp compiles into a header.
+
+    A table over N keys has N slots and a smaller array of displacements
+    ("hash and displace"): a key's hash picks a bucket, and the bucket's
+    displacement reseeds the hash that picks the slot. The generator chose
+    every displacement so that no two keys share a slot, so a lookup is one
+    slot read and one key compare.
+
+    Everything here is constexpr, so the generated tables can be probed at
+    compile time as well as at run time.
+*/
+
+// murmur3's 64-bit finalizer: every input bit affects every output bit
+constexpr uint64_t perfect_hash_mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= UINT64_C(0xff51afd7ed558ccd);
+    x ^= x >> 33;
+    x *= UINT64_C(0xc4ceb9fe1a85ec53);
+    x ^= x >> 33;
+    return x;
+}
+
+constexpr uint64_t perfect_hash_key(uint64_t key, uint64_t seed) {
+    return perfect_hash_mix(key ^ seed);
+}
+
+constexpr uint64_t perfect_hash_key(std::string_view key, uint64_t seed) {
+    uint64_t hash = UINT64_C(0xCBF29CE484222325) ^ seed;
+    for (char c : key) hash = (hash ^ static_cast<unsigned char>(c)) * UINT64_C(0x00000100000001B3);
+    return perfect_hash_mix(hash ^ key.size());
+}
+
+/* the key packing the generator uses for CIDR entries */
+constexpr uint64_t perfect_hash_prefix(uint32_t network, uint8_t length) {
+    return (static_cast<uint64_t>(network) << 8) | length;
+}
+
+/**
+ * ## Perfect Hash Index
+ * @brief Maps a key hash to its slot in a generated table.
+ */
+struct perfect_hash_index {
+    uint64_t seed;
+    uint32_t bucket_count;
+    uint32_t slot_count;               // 0 for an empty table
+    const uint32_t * displacements;
+
+    // bucket from the high half of the hash, so it is independent of the slot choice
+    static constexpr uint32_t bucket(uint64_t hash, uint32_t bucket_count) {
+        return static_cast<uint32_t>(((hash >> 32) * bucket_count) >> 32);
+    }
+
+    static constexpr uint32_t slot(uint64_t hash, uint32_t displacement, uint32_t slot_count) {
+        uint64_t reseeded = perfect_hash_mix(hash + displacement * UINT64_C(0x9E3779B97F4A7C15));
+        return static_cast<uint32_t>(((reseeded & 0xFFFFFFFFu) * slot_count) >> 32);
+    }
+
+    /**
+        @brief Returns the only slot key can occupy. Only meaningful when slot_count > 0.
+    **/
+    template <typename Key>
+    constexpr uint32_t find(const Key & key) const {
+        uint64_t hash = perfect_hash_key(key, this->seed);
+        return slot(hash, this->displacements[bucket(hash, this->bucket_count)], this->slot_count);
+    }
+};
@@ -0,0 +1,11 @@
+#pragma once
+
+/*
+    Hints the cache to start loading addr ahead of its use. Compiles to nothing
+    on compilers without the builtin.
+*/
+#if defined(__GNUC__) || defined(__clang__)
+#define MAP_PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define MAP_PREFETCH(addr) ((void)(addr))
+#endif
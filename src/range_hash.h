@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>  // size_t
+#include <cstdint>  // uint32_t, uint64_t
+
+#include "primes.h"
+
+/*
+    Bucket index policies for UnorderedMap.
+
+    Each policy picks the bucket array sizes it supports (size_for) and, once
+    constructed for a bucket count, maps a hash code into [0, bucket_count).
+    They differ only in how much work that mapping costs per lookup.
+*/
+
+/*
+    hash % bucket_count over prime sizes. The original mapping; costs a
+    64-bit hardware divide on every call.
+*/
+struct prime_mod_range {
+    size_t _count;
+
+    static size_t size_for(size_t count) { return next_greater_prime(count); }
+
+    explicit prime_mod_range(size_t bucket_count = 1) : _count(bucket_count) {}
+
+    size_t operator()(size_t hash_code) const { return hash_code % this->_count; }
+};
+
+/*
+    Exact modulo by a prime using a precomputed reciprocal (Lemire's fastmod),
+    which replaces the divide with two multiplies. The hash is folded to 32 bits
+    first, so bucket counts must stay below 2^32; larger tables fall back to %.
+*/
+struct prime_fastmod_range {
+    size_t _count;
+    uint64_t _reciprocal;
+
+    static size_t size_for(size_t count) { return next_greater_prime(count); }
+
+    explicit prime_fastmod_range(size_t bucket_count = 1)
+        : _count(bucket_count), _reciprocal(UINT64_C(0xFFFFFFFFFFFFFFFF) / bucket_count + 1) {}
+
+    size_t operator()(size_t hash_code) const {
+        if (this->_count > UINT32_MAX) return hash_code % this->_count;
+
+        uint64_t folded = static_cast<uint32_t>(hash_code ^ (static_cast<uint64_t>(hash_code) >> 32));
+        uint64_t low = this->_reciprocal * folded;
+
+        // high 64 bits of low * _count, without a 128-bit type
+        return static_cast<size_t>(((low >> 32) * this->_count + (((low & 0xFFFFFFFFu) * this->_count) >> 32)) >> 32);
+    }
+};
+
+/*
+    Lemire's fastrange: scales a 32-bit folded hash into [0, bucket_count) with
+    one multiply and a shift. Works for any size (primes are kept for parity with
+    the other policies) but uses the high bits of the fold, so it relies on the
+    hash mixing well. Bucket counts must stay below 2^32.
+*/
+struct fastrange_range {
+    size_t _count;
+
+    static size_t size_for(size_t count) { return next_greater_prime(count); }
+
+    explicit fastrange_range(size_t bucket_count = 1) : _count(bucket_count) {}
+
+    size_t operator()(size_t hash_code) const {
+        uint64_t folded = static_cast<uint32_t>(hash_code ^ (static_cast<uint64_t>(hash_code) >> 32));
+        return static_cast<size_t>((folded * this->_count) >> 32);
+    }
+};
+
+/*
+    Power-of-two sizes with Fibonacci hashing: multiply by 2^64 / phi and keep
+    the top bits. The multiply mixes every input bit into the index, so weak low
+    bits in the hash do not cluster the way a plain mask would.
+*/
+struct pow2_range {
+    unsigned _shift;
+
+    static size_t size_for(size_t count) {
+        size_t size = 2;
+        while (size < count) size *= 2;
+        return size;
+    }
+
+    explicit pow2_range(size_t bucket_count = 2) : _shift(64) {
+        while (bucket_count > 1) { bucket_count >>= 1; --this->_shift; }
+    }
+
+    size_t operator()(size_t hash_code) const {
+        return static_cast<size_t>((static_cast<uint64_t>(hash_code) * UINT64_C(0x9E3779B97F4A7C15)) >> this->_shift);
+    }
+};
@@ -0,0 +1,143 @@
+#include "reloadable_filter.h"
+
+#include <sys/stat.h>
+
+// the patterns a malicious_url_filter loads by default
+static const char * const PATTERNS_PATH = "resources/patterns.txt";
+
+// modification time of path in nanoseconds, or 0 if it cannot be read
+static int64_t _modified_time(std::string const & path) {
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) return 0;
+#if defined(__APPLE__)
+    return static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+}
+
+reloadable_filter::reloadable_filter(std::string const & path, std::chrono::milliseconds poll_interval)
+    : _path(path), _current(nullptr), _generation(1), _loaded(), _standby(), _update_lock(), _lock(), _wake(),
+      _reload_requested(false), _stopping(false), _poll_interval(poll_interval), _worker() {
+
+    // the text is kept so the standby can hold the same list; a missing file loads as empty
+    read_block_list(path, PATTERNS_PATH, this->_loaded);
+    this->_current.store(new malicious_url_filter(this->_loaded), std::memory_order_release);
+
+    this->_worker = std::thread(&reloadable_filter::_run, this);
+
+}
+
+reloadable_filter::~reloadable_filter() {
+
+    {
+        std::lock_guard<std::mutex> lock(this->_lock);
+        this->_stopping = true;
+    }
+    this->_wake.notify_one();
+    this->_worker.join();
+
+    // no reader may outlive the filter, so the last snapshot can go straight away
+    delete this->_current.load(std::memory_order_acquire);
+    epoch_domain::global().reclaim();
+
+}
+
+void reloadable_filter::reload() {
+    {
+        std::lock_guard<std::mutex> lock(this->_lock);
+        this->_reload_requested = true;
+    }
+    this->_wake.notify_one();
+}
+
+bool reloadable_filter::reload_now() {
+    return this->_rebuild();
+}
+
+bool reloadable_filter::_rebuild() {
+
+    std::lock_guard<std::mutex> writer(this->_update_lock);
+
+    // keep serving the old list rather than swapping in an empty one
+    block_list_text text;
+    if (!read_block_list(this->_path, PATTERNS_PATH, text)) return false;
+
+    // build the next snapshot, then publish it in one store
+    const malicious_url_filter * next = new malicious_url_filter(text);
+    const malicious_url_filter * previous = this->_current.exchange(next, std::memory_order_acq_rel);
+    this->_generation.fetch_add(1, std::memory_order_acq_rel);
+
+    // readers may still be inside the previous snapshot; free it once they are done
+    epoch_domain::global().retire(const_cast<malicious_url_filter*>(previous));
+    epoch_domain::global().reclaim();
+
+    // the standby held the old list plus its deltas; the next delta builds one from this text
+    this->_standby.reset();
+    this->_loaded = std::move(text);
+    return true;
+
+}
+
+bool reloadable_filter::apply_delta(const filter_delta & delta) {
+
+    std::lock_guard<std::mutex> writer(this->_update_lock);
+    if (delta.sequence <= this->_current.load(std::memory_order_acquire)->sequence()) return false;
+
+    // the first delta since the load builds the standby from the text the current copy was built from
+    if (!this->_standby) {
+        this->_standby.reset(new malicious_url_filter(this->_loaded));
+        this->_loaded = block_list_text();
+    }
+
+    // change the copy nobody reads, and publish it
+    this->_standby->apply_delta(delta);
+    const malicious_url_filter * previous = this->_current.exchange(this->_standby.release(), std::memory_order_acq_rel);
+    this->_generation.fetch_add(1, std::memory_order_acq_rel);
+
+    // then bring the replaced copy level once its last reader has left, and keep it as the standby
+    epoch_domain::global().wait_for_readers();
+    this->_standby.reset(const_cast<malicious_url_filter*>(previous));
+    this->_standby->apply_delta(delta);
+    return true;
+
+}
+
+bool reloadable_filter::apply_delta(std::string const & path) {
+    filter_delta delta;
+    return read_filter_delta(path, delta) && this->apply_delta(delta);
+}
+
+void reloadable_filter::_run() {
+
+    int64_t last_modified = _modified_time(this->_path);
+    std::unique_lock<std::mutex> lock(this->_lock);
+
+    while (!this->_stopping) {
+
+        // sleep until asked, or until the next poll when watching the file
+        if (this->_poll_interval.count() > 0)
+            this->_wake.wait_for(lock, this->_poll_interval, [this] { return this->_stopping || this->_reload_requested; });
+        else
+            this->_wake.wait(lock, [this] { return this->_stopping || this->_reload_requested; });
+        if (this->_stopping) break;
+
+        int64_t modified = _modified_time(this->_path);
+        bool changed = this->_poll_interval.count() > 0 && modified != last_modified;
+        if (!this->_reload_requested && !changed) {
+            // nothing to do but retry anything still waiting on slow readers
+            lock.unlock();
+            epoch_domain::global().reclaim();
+            lock.lock();
+            continue;
+        }
+        this->_reload_requested = false;
+
+        // build without holding the lock so reload() never waits on a rebuild
+        lock.unlock();
+        if (this->_rebuild()) last_modified = modified;
+        lock.lock();
+
+    }
+
+}
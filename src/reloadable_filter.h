@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "epoch.h"
+#include "malicious_url_filter.h"
+
+/**
+ * ## Reloadable Filter
+ * @brief A malicious_url_filter that can pick up a new block list while serving lookups.
+ *
+ * Lookups run against an immutable filter snapshot published through an atomic
+ * pointer: a reader pins an epoch, loads the pointer and queries it, without
+ * taking any lock. Reloads build the next snapshot on a background thread and
+ * swap it in with one atomic store; the previous snapshot is retired to the
+ * epoch domain and freed once no reader can still be using it.
+ *
+ * Deltas are applied left-right: to a standby copy that no reader can see,
+ * which is then published, and, once the last reader has left the copy it
+ * replaced, to that one too, which becomes the next standby. Each delta is
+ * then applied twice instead of the list being loaded again, at the price of
+ * holding the list twice. A load builds one copy and keeps the text it read;
+ * the first delta after it builds the standby from that text and drops it,
+ * so a filter that never gets a delta holds one copy plus the list's text.
+ */
+class reloadable_filter {
+    private:
+        std::string _path;
+        std::atomic<const malicious_url_filter*> _current;
+        std::atomic<uint64_t> _generation;
+
+        // the list as last loaded, kept until the first delta after the load builds the standby from it
+        block_list_text _loaded;
+        // the other copy of the current snapshot, for deltas, or null until the first delta after a load
+        std::unique_ptr<malicious_url_filter> _standby;
+        mutable std::mutex _update_lock;    // one writer at a time, reloading or applying a delta
+
+        // background reload thread state
+        std::mutex _lock;
+        std::condition_variable _wake;
+        bool _reload_requested;
+        bool _stopping;
+        std::chrono::milliseconds _poll_interval;
+        std::thread _worker;
+
+        void _run();
+        bool _rebuild();
+
+    public:
+        /**
+            @brief Loads path and starts the reload thread.
+
+            @param path the block list to load, one entry per line.
+            @param poll_interval if nonzero, how often to check path's modification time and reload on change.
+        **/
+        explicit reloadable_filter(std::string const & path = "resources/block.txt",
+                                   std::chrono::milliseconds poll_interval = std::chrono::milliseconds(0));
+
+        ~reloadable_filter();
+
+        reloadable_filter(const reloadable_filter &) = delete;
+        reloadable_filter & operator=(const reloadable_filter &) = delete;
+
+        /**
+            @brief Runs f(const malicious_url_filter &) against the current snapshot, keeping it alive until f returns.
+        **/
+        template <typename F>
+        auto with_snapshot(F && f) const {
+            epoch_domain::guard guard;
+            return f(*this->_current.load(std::memory_order_acquire));
+        }
+
+        bool is_Malicious_URL(std::string_view IP) const {
+            return this->with_snapshot([IP](const malicious_url_filter & filter) { return filter.is_Malicious_URL(IP); });
+        }
+
+        bool is_Malicious_Domain(std::string_view url) const {
+            return this->with_snapshot([url](const malicious_url_filter & filter) { return filter.is_Malicious_Domain(url); });
+        }
+
+        bool is_Malicious_Pattern(std::string_view url) const {
+            return this->with_snapshot([url](const malicious_url_filter & filter) { return filter.is_Malicious_Pattern(url); });
+        }
+
+        bool is_Malicious_IP(uint32_t IP) const {
+            return this->with_snapshot([IP](const malicious_url_filter & filter) { return filter.is_Malicious_IP(IP); });
+        }
+
+        bool is_Malicious_IP(std::string_view IP) const {
+            return this->with_snapshot([IP](const malicious_url_filter & filter) { return filter.is_Malicious_IP(IP); });
+        }
+
+        /**
+            @brief Statistics of the current snapshot. Lookup counts add up both copies, since deltas
+            swap them, and restart with each reload. Waits for a reload or delta in progress, so it
+            must not be called from inside with_snapshot().
+        **/
+        filter_stats stats() const {
+            std::lock_guard<std::mutex> writer(this->_update_lock);
+            filter_stats stats = this->with_snapshot([](const malicious_url_filter & filter) { return filter.stats(); });
+            if (this->_standby) this->_standby->add_lookup_counts(stats);
+            return stats;
+        }
+
+        /**
+            @brief Asks the background thread to rebuild from the block list. Returns immediately.
+        **/
+        void reload();
+
+        /**
+            @brief Rebuilds on the calling thread and publishes the result. Readers are never blocked.
+
+            @return false if the block list could not be opened; the current snapshot stays in place.
+        **/
+        bool reload_now();
+
+        /**
+            @brief Applies a delta without stopping lookups; readers see the whole batch or none of it.
+            The block list file is not read, so a delta applies to the list as last loaded even if
+            the file has changed since. Must not be called from inside with_snapshot().
+
+            @return false, changing nothing, if delta.sequence is not past sequence().
+        **/
+        bool apply_delta(const filter_delta & delta);
+
+        /**
+            @brief Reads the delta file at path and applies it, as apply_delta(const filter_delta &) does.
+        **/
+        bool apply_delta(std::string const & path);
+
+        /**
+            @brief The sequence number of the last delta applied since the last load, or 0.
+        **/
+        uint64_t sequence() const {
+            return this->with_snapshot([](const malicious_url_filter & filter) { return filter.sequence(); });
+        }
+
+        /**
+            @brief Number of snapshots published so far, starting at 1 for the initial load.
+            Every reload and every delta publishes one.
+        **/
+        uint64_t generation() const noexcept { return this->_generation.load(std::memory_order_acquire); }
+};
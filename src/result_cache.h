@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+#include "filter_stats.h"
+#include "hash_functions.h"
+
+#ifndef MALICIOUS_FILTER_CACHE_SLOTS
+// answers kept per thread (a power of two); eight bytes each, so the default takes 32 KB
+#define MALICIOUS_FILTER_CACHE_SLOTS 4096
+#endif
+
+/**
+ * ## Cached Filter
+ * @brief A small per-thread cache of answers in front of a filter, for traffic
+ * where a few thousand keys make up most of the queries.
+ *
+ * Each thread has its own table of 64-bit words, in two-way sets that share a
+ * cache line. A word holds a fingerprint of the key, the lookup asked and the
+ * filter's generation, with the answer in its low bit, so a repeated query
+ * costs one hash and one cache line. A new answer goes in front of its set and
+ * pushes the older one back, evicting the least recent. When the filter's
+ * generation() changes, every older fingerprint stops matching, so nothing
+ * has to be cleared. Two keys are only confused if their 62-bit fingerprints
+ * are equal.
+ *
+ * Filter is malicious_url_filter or reloadable_filter: anything with these
+ * lookups, generation() and stats(). The generation is read before each
+ * lookup, so an answer is never tagged with a newer list than it came from.
+ */
+template <typename Filter>
+class cached_filter {
+    private:
+        static constexpr size_t SLOTS = MALICIOUS_FILTER_CACHE_SLOTS;
+        static constexpr size_t SHARDS = 64;
+        static_assert(SLOTS >= 2 && (SLOTS & (SLOTS - 1)) == 0, "MALICIOUS_FILTER_CACHE_SLOTS must be a power of two");
+
+        // which lookup a fingerprint is for, so the same text asked two ways gets two answers
+        enum lookup_kind : uint64_t { BY_URL = 1, BY_DOMAIN, BY_PATTERN, BY_ADDRESS, BY_ADDRESS_TEXT };
+
+        struct alignas(64) shard {
+            std::atomic<uint64_t> hits;
+            std::atomic<uint64_t> misses;
+        };
+
+        const Filter & _filter;
+        uint64_t _salt;     // keeps this cache's entries apart from other caches' on the same thread
+        std::unique_ptr<shard[]> _shards;
+
+        static uint64_t * _slots() {
+            alignas(64) static thread_local uint64_t slots[SLOTS] = { };
+            return slots;
+        }
+
+        static uint64_t _next_salt() {
+            static std::atomic<uint64_t> next { 0 };
+            return hash_mix(next.fetch_add(1, std::memory_order_relaxed) + 1, UINT64_C(0xa0761d6478bd642f));
+        }
+
+        static void _bump(std::atomic<uint64_t> & counter) {
+            counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        template <typename F>
+        bool _cached(uint64_t key, lookup_kind kind, F && lookup) const {
+            // the top bit is always set, so an empty (zero) slot never matches; the low bit is left for the answer
+            uint64_t fingerprint = hash_mix(key ^ this->_salt ^ (kind << 56), this->_filter.generation() ^ UINT64_C(0x9E3779B97F4A7C15));
+            fingerprint = (fingerprint | (UINT64_C(1) << 63)) & ~UINT64_C(1);
+
+            uint64_t * set = _slots() + ((fingerprint >> 1) & (SLOTS / 2 - 1)) * 2;
+            shard & mine = this->_shards[counter_shard(SHARDS)];
+            if ((set[0] & ~UINT64_C(1)) == fingerprint) {
+                _bump(mine.hits);
+                return set[0] & 1;
+            }
+            if ((set[1] & ~UINT64_C(1)) == fingerprint) {
+                // used again, so it moves to the front
+                uint64_t found = set[1];
+                set[1] = set[0];
+                set[0] = found;
+                _bump(mine.hits);
+                return found & 1;
+            }
+
+            bool hit = lookup();
+            set[1] = set[0];
+            set[0] = fingerprint | hit;
+            _bump(mine.misses);
+            return hit;
+        }
+
+    public:
+        /**
+            @param filter the filter to answer from; it must outlive the cache.
+        **/
+        explicit cached_filter(const Filter & filter) : _filter(filter), _salt(_next_salt()), _shards(new shard[SHARDS]) {
+            for (size_t s = 0; s < SHARDS; ++s) {
+                this->_shards[s].hits.store(0, std::memory_order_relaxed);
+                this->_shards[s].misses.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        bool is_Malicious_URL(std::string_view IP) const {
+            return this->_cached(wy_hash()(IP), BY_URL, [this, IP] { return this->_filter.is_Malicious_URL(IP); });
+        }
+
+        bool is_Malicious_Domain(std::string_view url) const {
+            return this->_cached(wy_hash()(url), BY_DOMAIN, [this, url] { return this->_filter.is_Malicious_Domain(url); });
+        }
+
+        bool is_Malicious_Pattern(std::string_view url) const {
+            return this->_cached(wy_hash()(url), BY_PATTERN, [this, url] { return this->_filter.is_Malicious_Pattern(url); });
+        }
+
+        bool is_Malicious_IP(uint32_t IP) const {
+            return this->_cached(IP, BY_ADDRESS, [this, IP] { return this->_filter.is_Malicious_IP(IP); });
+        }
+
+        bool is_Malicious_IP(std::string_view IP) const {
+            return this->_cached(wy_hash()(IP), BY_ADDRESS_TEXT, [this, IP] { return this->_filter.is_Malicious_IP(IP); });
+        }
+
+        /**
+            @brief The filter's statistics, with the answers this cache served (hits) and passed on (misses), over all threads.
+        **/
+        filter_stats stats() const {
+            filter_stats stats = this->_filter.stats();
+            stats.cached = true;
+            for (size_t s = 0; s < SHARDS; ++s) {
+                stats.cache_hits += this->_shards[s].hits.load(std::memory_order_relaxed);
+                stats.cache_misses += this->_shards[s].misses.load(std::memory_order_relaxed);
+            }
+            return stats;
+        }
+};
@@ -0,0 +1,320 @@
+#include "snapshot.h"
+#include "hash_functions.h"
+#include "url.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const uint64_t SECTION_ALIGN = 64;
+
+static uint64_t _align(uint64_t offset) { return (offset + SECTION_ALIGN - 1) & ~(SECTION_ALIGN - 1); }
+
+static void _pad(std::ofstream & out, uint64_t from, uint64_t to) {
+    static const char zeros[SECTION_ALIGN] = { };
+    out.write(zeros, static_cast<std::streamsize>(to - from));
+}
+
+// flushes path's data to disk, so a rename never exposes a file whose bytes are not there yet
+static bool _sync(std::string const & path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    bool ok = ::fsync(fd) == 0;
+    return ::close(fd) == 0 && ok;
+}
+
+bool write_snapshot(std::string const & path, const ipv4_lpm & prefixes, const ipv4_prefix_set & networks,
+                    const std::vector<ipv6_prefix> & networks6, const std::vector<std::string_view> & keys,
+                    const std::vector<std::string_view> & hosts) {
+
+    fnv1a_hash hash;
+
+    // build the exact-match table at no more than half full
+    uint64_t slot_count = 0;
+    if (!keys.empty() || !hosts.empty()) {
+        slot_count = 1;
+        while (slot_count < (keys.size() + hosts.size()) * 2) slot_count *= 2;
+    }
+    std::vector<snapshot_slot> slots(slot_count, snapshot_slot { 0, 0, SNAPSHOT_EMPTY_SLOT });
+    std::string strings;
+    uint64_t key_count = 0;
+
+    // the keys first, so a host that is also a key keeps the key's slot
+    auto add = [&](std::string_view key, uint32_t flag) {
+        uint64_t h = hash(key);
+        uint64_t i = h & (slot_count - 1);
+
+        // probe until an empty slot, skipping duplicates
+        while (slots[i].length != SNAPSHOT_EMPTY_SLOT) {
+            uint32_t length = slots[i].length & ~SNAPSHOT_HOST_SLOT;
+            if (slots[i].hash == h && std::string_view(strings.data() + slots[i].offset, length) == key) return;
+            i = (i + 1) & (slot_count - 1);
+        }
+
+        slots[i] = snapshot_slot { h, static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(key.size()) | flag };
+        strings.append(key.data(), key.size());
+        ++key_count;
+    };
+    for (std::string_view key : keys) add(key, 0);
+    for (std::string_view host : hosts) add(host, SNAPSHOT_HOST_SLOT);
+
+    // group the IPv6 networks by length, sorted within each length
+    std::vector<ipv6_prefix> grouped(networks6);
+    std::sort(grouped.begin(), grouped.end(), [](const ipv6_prefix & a, const ipv6_prefix & b) {
+        return a.length != b.length ? a.length < b.length : a.network < b.network;
+    });
+    std::vector<ipv6_address> addresses6;
+    addresses6.reserve(grouped.size());
+    for (const ipv6_prefix & prefix : grouped) addresses6.push_back(prefix.network);
+
+    // lay out the sections
+    const std::vector<uint32_t> & root = prefixes.root_table();
+    const std::vector<uint32_t> & chunks = prefixes.chunk_table();
+
+    snapshot_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.header_size = sizeof(snapshot_header);
+    header.root_offset = _align(sizeof(snapshot_header));
+    header.chunks_offset = _align(header.root_offset + root.size() * sizeof(uint32_t));
+    header.chunk_entries = chunks.size();
+    header.networks_offset = _align(header.chunks_offset + chunks.size() * sizeof(uint32_t));
+    for (size_t length = 0; length < ipv4_prefix_set::LENGTHS; ++length) {
+        header.network_starts[length] = header.network_count;
+        header.network_count += networks.networks(static_cast<uint8_t>(length)).size();
+    }
+    header.network_starts[ipv4_prefix_set::LENGTHS] = header.network_count;
+    header.networks6_offset = _align(header.networks_offset + header.network_count * sizeof(uint32_t));
+    header.network6_count = grouped.size();
+    for (size_t length = 0, i = 0; length <= SNAPSHOT_IPV6_LENGTHS; ++length) {
+        header.network6_starts[length] = i;
+        if (i < grouped.size() && grouped[i].length == length) header.network6_lengths[length / 64] |= uint64_t(1) << (length % 64);
+        while (i < grouped.size() && grouped[i].length == length) ++i;
+    }
+    header.slots_offset = _align(header.networks6_offset + header.network6_count * sizeof(ipv6_address));
+    header.slot_count = slot_count;
+    header.strings_offset = _align(header.slots_offset + slot_count * sizeof(snapshot_slot));
+    header.strings_size = strings.size();
+    header.file_size = header.strings_offset + strings.size();
+    header.key_count = key_count;
+    header.prefix_count = prefixes.size();
+
+    // write them to a temporary file next to path; processes mapping path keep the old file until the rename
+    std::string temporary = path + ".tmp";
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    _pad(out, sizeof(header), header.root_offset);
+    out.write(reinterpret_cast<const char*>(root.data()), static_cast<std::streamsize>(root.size() * sizeof(uint32_t)));
+    _pad(out, header.root_offset + root.size() * sizeof(uint32_t), header.chunks_offset);
+    out.write(reinterpret_cast<const char*>(chunks.data()), static_cast<std::streamsize>(chunks.size() * sizeof(uint32_t)));
+    _pad(out, header.chunks_offset + chunks.size() * sizeof(uint32_t), header.networks_offset);
+    for (size_t length = 0; length < ipv4_prefix_set::LENGTHS; ++length) {
+        const std::vector<uint32_t> & sorted = networks.networks(static_cast<uint8_t>(length));
+        out.write(reinterpret_cast<const char*>(sorted.data()), static_cast<std::streamsize>(sorted.size() * sizeof(uint32_t)));
+    }
+    _pad(out, header.networks_offset + header.network_count * sizeof(uint32_t), header.networks6_offset);
+    out.write(reinterpret_cast<const char*>(addresses6.data()), static_cast<std::streamsize>(addresses6.size() * sizeof(ipv6_address)));
+    _pad(out, header.networks6_offset + header.network6_count * sizeof(ipv6_address), header.slots_offset);
+    out.write(reinterpret_cast<const char*>(slots.data()), static_cast<std::streamsize>(slots.size() * sizeof(snapshot_slot)));
+    _pad(out, header.slots_offset + slots.size() * sizeof(snapshot_slot), header.strings_offset);
+    out.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+
+    out.close();
+    if (!out || !_sync(temporary) || ::rename(temporary.c_str(), path.c_str()) != 0) {
+        ::unlink(temporary.c_str());
+        return false;
+    }
+    return true;
+
+}
+
+// a section [offset, offset + bytes) is usable if it lies inside the file and is aligned for its entries
+static bool _section_ok(uint64_t offset, uint64_t bytes, uint64_t file_size, uint64_t align) {
+    return offset % align == 0 && offset <= file_size && bytes <= file_size - offset;
+}
+
+mapped_filter::mapped_filter(std::string const & path) : mapped_filter() {
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(snapshot_header)) {
+        ::close(fd);
+        return;
+    }
+
+    // a shared read-only mapping lets every process use the same page cache copy
+    size_t size = static_cast<size_t>(st.st_size);
+    void * base = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) return;
+
+    this->_base = static_cast<const unsigned char*>(base);
+    this->_size = size;
+
+    // validate the header and section bounds before trusting any offset
+    const snapshot_header * header = reinterpret_cast<const snapshot_header*>(this->_base);
+    bool ok = std::memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) == 0
+        && header->version == SNAPSHOT_VERSION
+        && header->header_size == sizeof(snapshot_header)
+        && header->file_size == size
+        && header->chunk_entries % ipv4_lpm::CHUNK_SIZE == 0
+        && (header->slot_count & (header->slot_count - 1)) == 0
+        && header->chunk_entries <= size && header->slot_count <= size
+        && _section_ok(header->root_offset, ipv4_lpm::ROOT_SIZE * sizeof(uint32_t), size, sizeof(uint32_t))
+        && _section_ok(header->chunks_offset, header->chunk_entries * sizeof(uint32_t), size, sizeof(uint32_t))
+        && header->network_count <= size
+        && _section_ok(header->networks_offset, header->network_count * sizeof(uint32_t), size, sizeof(uint32_t))
+        && header->network6_count <= size
+        && _section_ok(header->networks6_offset, header->network6_count * sizeof(ipv6_address), size, alignof(ipv6_address))
+        && _section_ok(header->slots_offset, header->slot_count * sizeof(snapshot_slot), size, alignof(snapshot_slot))
+        && _section_ok(header->strings_offset, header->strings_size, size, 1);
+
+    // every length's range must sit inside the networks section
+    for (size_t length = 0; ok && length < ipv4_prefix_set::LENGTHS; ++length)
+        ok = header->network_starts[length] <= header->network_starts[length + 1];
+    ok = ok && header->network_starts[0] == 0 && header->network_starts[ipv4_prefix_set::LENGTHS] == header->network_count;
+    for (size_t length = 0; ok && length < SNAPSHOT_IPV6_LENGTHS; ++length)
+        ok = header->network6_starts[length] <= header->network6_starts[length + 1];
+    ok = ok && header->network6_starts[0] == 0 && header->network6_starts[SNAPSHOT_IPV6_LENGTHS] == header->network6_count;
+
+    // a marked length must have networks, and no length past 128 may be marked
+    for (size_t length = 0; ok && length < SNAPSHOT_IPV6_LENGTHS; ++length)
+        if (header->network6_lengths[length / 64] >> (length % 64) & 1)
+            ok = header->network6_starts[length] < header->network6_starts[length + 1];
+    ok = ok && (header->network6_lengths[2] >> 1) == 0;
+
+    if (!ok) {
+        this->_close();
+        return;
+    }
+
+    this->_header = header;
+    this->_root = reinterpret_cast<const uint32_t*>(this->_base + header->root_offset);
+    this->_chunks = reinterpret_cast<const uint32_t*>(this->_base + header->chunks_offset);
+    this->_networks = reinterpret_cast<const uint32_t*>(this->_base + header->networks_offset);
+    this->_networks6 = reinterpret_cast<const ipv6_address*>(this->_base + header->networks6_offset);
+    this->_slots = reinterpret_cast<const snapshot_slot*>(this->_base + header->slots_offset);
+    this->_strings = reinterpret_cast<const char*>(this->_base + header->strings_offset);
+
+}
+
+mapped_filter::mapped_filter(mapped_filter && other) noexcept : mapped_filter() {
+    *this = std::move(other);
+}
+
+mapped_filter & mapped_filter::operator=(mapped_filter && other) noexcept {
+    if (&other == this) return *this;
+    this->_close();
+
+    this->_base = other._base;
+    this->_size = other._size;
+    this->_header = other._header;
+    this->_root = other._root;
+    this->_chunks = other._chunks;
+    this->_networks = other._networks;
+    this->_networks6 = other._networks6;
+    this->_slots = other._slots;
+    this->_strings = other._strings;
+
+    other._base = nullptr;
+    other._size = 0;
+    other._header = nullptr;
+    return *this;
+}
+
+void mapped_filter::_close() noexcept {
+    if (this->_base != nullptr) ::munmap(const_cast<unsigned char*>(this->_base), this->_size);
+    this->_base = nullptr;
+    this->_size = 0;
+    this->_header = nullptr;
+}
+
+bool mapped_filter::is_Malicious_URL(std::string_view IP) const {
+
+    if (this->_header == nullptr) return false;
+
+    // CIDR entries are searched in their length's sorted networks
+    ipv4_prefix prefix;
+    if (parse_ipv4_cidr(IP, prefix)) {
+        const uint64_t * starts = this->_header->network_starts;
+        return ipv4_prefix_set::contains(this->_networks + starts[prefix.length],
+                                         starts[prefix.length + 1] - starts[prefix.length], prefix.network);
+    }
+    ipv6_prefix prefix6;
+    if (parse_ipv6_cidr(IP, prefix6)) return this->_has_network6(prefix6.network, prefix6.length);
+
+    return this->_has_key(IP, false);
+
+}
+
+bool mapped_filter::is_Malicious_Domain(std::string_view url) const {
+
+    if (this->_header == nullptr) return false;
+
+    char buffer[URL_HOST_MAX];
+    std::string_view host;
+    if (!extract_url_host(url, buffer, host)) return false;
+
+    uint32_t address;
+    if (parse_ipv4(host, address)) return this->is_Malicious_IP(address);
+    ipv6_address address6;
+    if (host.front() == '[')
+        return parse_ipv6(host.substr(1, host.size() - 2), address6) && this->is_Malicious_IP(address6);
+
+    do {
+        if (this->_has_key(host, true)) return true;
+    } while (parent_domain(host));
+    return false;
+
+}
+
+bool mapped_filter::_has_key(std::string_view key, bool host) const {
+
+    if (this->_header->slot_count == 0) return false;
+
+    uint64_t mask = this->_header->slot_count - 1;
+    uint64_t h = fnv1a_hash()(key);
+
+    // linear probe until the key or an empty slot
+    for (uint64_t i = h & mask; ; i = (i + 1) & mask) {
+        const snapshot_slot & slot = this->_slots[i];
+        if (slot.length == SNAPSHOT_EMPTY_SLOT) return false;
+        if (slot.hash == h && (slot.length & ~SNAPSHOT_HOST_SLOT) == key.size()
+            && std::memcmp(this->_strings + slot.offset, key.data(), key.size()) == 0)
+            return host || !(slot.length & SNAPSHOT_HOST_SLOT);
+    }
+
+}
+
+bool mapped_filter::is_Malicious_IP(const ipv6_address & IP) const {
+
+    if (this->_header == nullptr) return false;
+
+    // the networks are grouped by length, so try only the lengths the header marks
+    for (size_t word = 0; word < 3; ++word) {
+        for (uint64_t lengths = this->_header->network6_lengths[word]; lengths != 0; lengths &= lengths - 1) {
+            uint8_t length = static_cast<uint8_t>(word * 64 + static_cast<size_t>(__builtin_ctzll(lengths)));
+            if (this->_has_network6(ipv6_mask(IP, length), length)) return true;
+        }
+    }
+    return false;
+
+}
+
+bool mapped_filter::_has_network6(const ipv6_address & network, uint8_t length) const {
+    if (length >= SNAPSHOT_IPV6_LENGTHS) return false;
+    const ipv6_address * first = this->_networks6 + this->_header->network6_starts[length];
+    const ipv6_address * last = this->_networks6 + this->_header->network6_starts[length + 1];
+    return std::binary_search(first, last, network);
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ipv4_lpm.h"
+#include "ipv4_prefix_set.h"
+#include "ipv6.h"
+
+/*
+    Prebuilt block list snapshots.
+
+    A snapshot is the built index written out with offsets instead of pointers,
+    so a process can mmap it and answer lookups straight from the mapping: no
+    parsing and no per-process copy, since every worker mapping the same file
+    shares its pages through the page cache.
+
+    Layout (native byte order, every section 64-byte aligned):
+        snapshot_header
+        root      ipv4_lpm::ROOT_SIZE uint32_t trie entries
+        chunks    chunk_entries uint32_t trie entries
+        networks  network_count uint32_t sorted network addresses, grouped by
+                  prefix length; length L is [network_starts[L], network_starts[L + 1])
+        networks6 network6_count ipv6_address sorted IPv6 networks, grouped the
+                  same way by network6_starts
+        slots     slot_count snapshot_slot, open addressing with linear probing
+        strings   the exact-match key bytes the slots point into
+
+    A slot whose length has SNAPSHOT_HOST_SLOT set holds a lowercased host
+    that only domain lookups match, like the filter's own lowercased hosts.
+
+    CIDR entries live in the networks sections; the exact-match table only
+    holds the entries that are not IPv4 or IPv6 prefixes. There is no IPv6
+    trie: an address is checked against each length that has networks, which
+    network6_lengths marks.
+
+    The exact-match table hashes with fnv1a_hash, which is stable across
+    machines. Bump SNAPSHOT_VERSION whenever the layout changes.
+*/
+
+static constexpr char SNAPSHOT_MAGIC[8] = { 'M', 'U', 'F', 'S', 'N', 'A', 'P', '\0' };
+static constexpr uint32_t SNAPSHOT_VERSION = 5;
+static constexpr size_t SNAPSHOT_IPV6_LENGTHS = 129;
+
+struct snapshot_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t file_size;
+    uint64_t root_offset;
+    uint64_t chunks_offset;
+    uint64_t chunk_entries;
+    uint64_t networks_offset;
+    uint64_t network_count;
+    uint64_t network_starts[ipv4_prefix_set::LENGTHS + 1];
+    uint64_t networks6_offset;
+    uint64_t network6_count;
+    uint64_t network6_starts[SNAPSHOT_IPV6_LENGTHS + 1];
+    uint64_t network6_lengths[3];   // bit L % 64 of word L / 64 is set when length L has networks
+    uint64_t slots_offset;
+    uint64_t slot_count;     // a power of two, or 0 when there are no exact-match keys
+    uint64_t strings_offset;
+    uint64_t strings_size;
+    uint64_t key_count;
+    uint64_t prefix_count;
+};
+
+struct snapshot_slot {
+    uint64_t hash;
+    uint32_t offset;         // into the string section
+    uint32_t length;         // EMPTY_SLOT marks an unused slot; HOST_SLOT is or-ed in for a host-only key
+};
+
+static constexpr uint32_t SNAPSHOT_EMPTY_SLOT = 0xFFFFFFFFu;
+static constexpr uint32_t SNAPSHOT_HOST_SLOT = 0x80000000u;
+
+/**
+    @brief Serializes a prefix table, its prefix set, the IPv6 prefixes and a set of exact-match keys to path.
+
+    @param path the file to (over)write.
+    @param prefixes the built IPv4 prefix table.
+    @param networks the built set of the same prefixes, for exact CIDR lookups.
+    @param networks6 the IPv6 prefixes, without duplicates.
+    @param keys the exact-match keys; duplicates are stored once.
+    @param hosts lowercased hosts that only domain lookups match; one also in keys is stored once, as a key.
+    @return true if the whole file was written and synced, then renamed over path. On false,
+    path is untouched.
+
+    The file is built as path + ".tmp" and renamed into place, so processes that
+    have path mapped keep reading the old snapshot rather than a torn or
+    truncated one; they see the new one when they map path again.
+**/
+bool write_snapshot(std::string const & path, const ipv4_lpm & prefixes, const ipv4_prefix_set & networks,
+                    const std::vector<ipv6_prefix> & networks6, const std::vector<std::string_view> & keys,
+                    const std::vector<std::string_view> & hosts);
+
+/**
+ * ## Mapped Filter
+ * @brief Serves filter lookups directly from a memory-mapped snapshot.
+ *
+ * Opening costs an mmap and a header check; nothing is parsed or copied.
+ * The file is trusted to come from write_snapshot: the header and section
+ * bounds are validated, the entries inside them are not.
+ */
+class mapped_filter {
+    private:
+        const unsigned char * _base;
+        size_t _size;
+        const snapshot_header * _header;
+        const uint32_t * _root;
+        const uint32_t * _chunks;
+        const uint32_t * _networks;
+        const ipv6_address * _networks6;
+        const snapshot_slot * _slots;
+        const char * _strings;
+
+        void _close() noexcept;
+
+        // probes the exact-match table, host-only keys too if host; the caller has checked the header
+        bool _has_key(std::string_view key, bool host) const;
+
+        // searches the IPv6 networks of one length; the caller has checked the header
+        bool _has_network6(const ipv6_address & network, uint8_t length) const;
+
+    public:
+        mapped_filter() : _base(nullptr), _size(0), _header(nullptr), _root(nullptr),
+            _chunks(nullptr), _networks(nullptr), _networks6(nullptr), _slots(nullptr), _strings(nullptr) {}
+
+        /**
+            @brief Maps the snapshot at path. Check is_open() for success.
+        **/
+        explicit mapped_filter(std::string const & path);
+
+        ~mapped_filter() { this->_close(); }
+
+        mapped_filter(const mapped_filter &) = delete;
+        mapped_filter & operator=(const mapped_filter &) = delete;
+
+        mapped_filter(mapped_filter && other) noexcept;
+        mapped_filter & operator=(mapped_filter && other) noexcept;
+
+        bool is_open() const noexcept { return this->_header != nullptr; }
+
+        /**
+            @brief Determines if IP exactly matches a block list entry. CIDR text is
+            compared as a prefix, so it matches however the entry wrote its host bits.
+        **/
+        bool is_Malicious_URL(std::string_view IP) const;
+
+        /**
+            @brief Determines if the host of url is a blocked domain or lies under one.
+            An IPv4 or bracketed IPv6 host is checked against the blocked ranges instead.
+        **/
+        bool is_Malicious_Domain(std::string_view url) const;
+
+        /**
+            @brief Determines if IP falls inside any blocked CIDR range.
+        **/
+        bool is_Malicious_IP(uint32_t IP) const {
+            if (this->_header == nullptr) return false;
+            return ipv4_lpm::longest_match(this->_root, this->_chunks, IP) >= 0;
+        }
+
+        bool is_Malicious_IP(const ipv6_address & IP) const;
+
+        bool is_Malicious_IP(std::string_view IP) const {
+            uint32_t address;
+            if (parse_ipv4(IP, address)) return this->is_Malicious_IP(address);
+            ipv6_address address6;
+            return parse_ipv6(IP, address6) && this->is_Malicious_IP(address6);
+        }
+
+        size_t key_count() const noexcept { return this->_header ? this->_header->key_count : 0; }
+        size_t prefix_count() const noexcept { return this->_header ? this->_header->prefix_count : 0; }
+        size_t ipv6_prefix_count() const noexcept { return this->_header ? this->_header->network6_count : 0; }
+        size_t mapped_size() const noexcept { return this->_size; }
+};
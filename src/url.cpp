@@ -0,0 +1,116 @@
+#include "url.h"
+
+#include <cstdint>
+
+// byte classes below every byte that can appear in a host name ('-' is the lowest)
+enum : unsigned char { _INVALID = 0, _END = 1, _AT = 2, _COLON = 3, _HOST = '-' };
+
+/*
+    One entry per byte: the byte as it is stored in a host, with ASCII letters
+    lowercased, or one of the classes above. Looking a byte up here classifies
+    and normalizes it in one load.
+*/
+struct _host_bytes {
+    unsigned char map[256];
+
+    constexpr _host_bytes() : map() {
+        for (int c = '0'; c <= '9'; ++c) map[c] = static_cast<unsigned char>(c);
+        for (int c = 'a'; c <= 'z'; ++c) map[c] = static_cast<unsigned char>(c);
+        for (int c = 'A'; c <= 'Z'; ++c) map[c] = static_cast<unsigned char>(c - 'A' + 'a');
+        for (int c = 0x80; c < 0x100; ++c) map[c] = static_cast<unsigned char>(c);
+        map[static_cast<unsigned char>('-')] = '-';
+        map[static_cast<unsigned char>('.')] = '.';
+        map[static_cast<unsigned char>('_')] = '_';
+
+        // the path, query or fragment ends the authority
+        map[static_cast<unsigned char>('/')] = _END;
+        map[static_cast<unsigned char>('?')] = _END;
+        map[static_cast<unsigned char>('#')] = _END;
+        map[static_cast<unsigned char>('\\')] = _END;
+        map[static_cast<unsigned char>('@')] = _AT;
+        map[static_cast<unsigned char>(':')] = _COLON;
+    }
+};
+
+static constexpr _host_bytes _host_map;
+
+static inline bool _is_alpha(char c) { return static_cast<unsigned char>((c | 0x20) - 'a') < 26; }
+
+static inline bool _is_scheme_char(char c) {
+    return _is_alpha(c) || static_cast<unsigned char>(c - '0') < 10 || c == '+' || c == '-' || c == '.';
+}
+
+/*
+    The host is a bracketed IPv6 literal starting at p. It is kept with its
+    brackets, and must be followed by a port or the end of the authority.
+*/
+static bool _extract_bracketed(const char * p, const char * end, char * buffer, std::string_view & host) {
+
+    size_t length = 0;
+    while (p + length < end && p[length] != ']') ++length;
+    if (p + length == end) return false;
+    ++length;
+    if (length > URL_HOST_MAX) return false;
+
+    const char * after = p + length;
+    if (after != end && _host_map.map[static_cast<unsigned char>(*after)] != _END && *after != ':') return false;
+
+    for (size_t i = 0; i < length; ++i) {
+        unsigned char c = static_cast<unsigned char>(p[i]);
+        unsigned char mapped = _host_map.map[c];
+        if (c == '[' || c == ']' || c == ':') mapped = c;
+        else if (mapped < _HOST) return false;
+        buffer[i] = static_cast<char>(mapped);
+    }
+
+    host = std::string_view(buffer, length);
+    return true;
+
+}
+
+bool extract_url_host(std::string_view url, char * buffer, std::string_view & host) {
+
+    const char * p = url.data();
+    const char * end = p + url.size();
+
+    // skip "scheme://" or "//"; anything else is taken to start at the authority
+    const char * s = p;
+    if (s < end && _is_alpha(*s)) {
+        while (++s < end && _is_scheme_char(*s)) {}
+        if (end - s >= 3 && s[0] == ':' && s[1] == '/' && s[2] == '/') p = s + 3;
+    } else if (end - p >= 2 && p[0] == '/' && p[1] == '/') {
+        p += 2;
+    }
+
+    // one pass over the authority, copying normalized bytes as it goes:
+    // an '@' discards what came before (user info), and the first ':' after it starts the port
+    size_t written = 0;
+    size_t port = SIZE_MAX;
+    bool invalid = false;
+    for (; p < end; ++p) {
+        unsigned char mapped = _host_map.map[static_cast<unsigned char>(*p)];
+        if (mapped >= _HOST) {
+            if (written < URL_HOST_MAX) buffer[written] = static_cast<char>(mapped);
+            ++written;
+            continue;
+        }
+        if (mapped == _END) break;
+        if (mapped == _AT) {
+            written = 0;
+            port = SIZE_MAX;
+            invalid = false;
+        } else if (port == SIZE_MAX) {
+            if (mapped == _COLON) port = written;
+            else if (*p == '[' && written == 0) return _extract_bracketed(p, end, buffer, host);
+            else invalid = true;
+        }
+    }
+
+    size_t length = port == SIZE_MAX ? written : port;
+    if (length > 0 && length <= URL_HOST_MAX && buffer[length - 1] == '.') --length;
+    if (invalid || length == 0 || length > URL_HOST_MAX) return false;
+
+    host = std::string_view(buffer, length);
+    return true;
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+// the longest host extract_url_host accepts; DNS names are at most 253 bytes
+static constexpr size_t URL_HOST_MAX = 255;
+
+/**
+    @brief Finds the host of a URL and writes it, normalized, into buffer.
+
+    Accepts "scheme://authority/...", "//authority/..." and a bare
+    "authority/...". Any user info and port are dropped, ASCII letters are
+    lowercased, and a trailing dot is removed. Bytes of 0x80 and above are
+    kept as they are (no IDNA mapping). A bracketed IPv6 literal is returned
+    with its brackets. Nothing is allocated.
+
+    @param url the URL or host to parse.
+    @param buffer receives the host; must have room for URL_HOST_MAX bytes.
+    @param host receives a view of the host inside buffer.
+    @return false if there is no host, it is too long, or it contains a byte not allowed in a host name.
+**/
+bool extract_url_host(std::string_view url, char * buffer, std::string_view & host);
+
+/**
+    @brief Removes the first label of a host name, e.g. "a.evil.com" becomes "evil.com".
+
+    @param host the name to shorten in place.
+    @return false, leaving host unchanged, if it has only one label.
+**/
+inline bool parent_domain(std::string_view & host) {
+    size_t dot = host.find('.');
+    if (dot == std::string_view::npos) return false;
+    host.remove_prefix(dot + 1);
+    return true;
+}
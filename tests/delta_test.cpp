@@ -0,0 +1,250 @@
+// Checks that applying deltas to a loaded filter gives the same answers as loading
+// the resulting list from scratch, including the edge cases that went wrong before:
+// one prefix removed under two spellings, a host listed in several letter cases,
+// and a block list edited between deltas to a reloadable_filter.
+//
+// Build from the repository root:
+//     g++ -O2 -std=c++17 -Isrc tests/delta_test.cpp $(ls src/*.cpp | grep -v main.cpp) -pthread -o delta_test
+// Run:
+//     ./delta_test [scratch directory, default /tmp]
+// Exits nonzero on any disagreement.
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "filter_delta.h"
+#include "malicious_url_filter.h"
+#include "reloadable_filter.h"
+
+static size_t failures = 0;
+
+static void check(bool ok, std::string const & what) {
+    if (ok) return;
+    std::cerr << "FAIL: " << what << "\n";
+    ++failures;
+}
+
+static bool write_list(std::string const & path, std::string const & text) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << text;
+    return static_cast<bool>(file.flush());
+}
+
+static filter_delta parse(std::string const & text) {
+    filter_delta delta;
+    check(parse_filter_delta(text, delta), "parse " + text);
+    return delta;
+}
+
+// the text format: "# seq" is required, the last line for an entry wins, '\r' and comments are skipped
+static void check_parser() {
+    filter_delta delta;
+    check(!parse_filter_delta("+ evil.example\n", delta), "a delta without \"# seq\" is rejected");
+    check(!parse_filter_delta("# seq 1\nevil.example\n", delta), "a line without + or - is rejected");
+
+    delta = parse("# note\r\n# seq 5\r\n+ a\r\n- b\n\n+ b\n- a\n");
+    check(delta.sequence == 5, "the sequence number is read");
+    check(delta.added == std::vector<std::string> { "b" } && delta.removed == std::vector<std::string> { "a" },
+          "the last line for each entry wins");
+}
+
+// "1.2.3.4" and "1.2.3.4/32" are one prefix, so removing both spellings removes it once
+static void check_two_spellings(std::string const & directory) {
+    std::string path = directory + "/delta_test_spellings.txt";
+    write_list(path, "1.2.3.4\n1.2.3.9\n2001:db8::1\n2001:db8::9\n");
+    malicious_url_filter filter(path, "", 1);
+    check(filter.prefix_count() == 2 && filter.range_count() == 2 && filter.ipv6_prefix_count() == 2, "the list loads");
+
+    check(filter.apply_delta(parse("# seq 1\n- 1.2.3.4\n- 1.2.3.4/32\n- 2001:db8::1\n- 2001:DB8::1/128\n")), "the delta applies");
+    check(filter.prefix_count() == 1, "one IPv4 prefix is left");
+    check(filter.range_count() == 1, "one IPv4 range is left (range_count " + std::to_string(filter.range_count()) + ")");
+    check(filter.ipv6_prefix_count() == 1, "one IPv6 prefix is left");
+    check(!filter.is_Malicious_IP("1.2.3.4") && filter.is_Malicious_IP("1.2.3.9"), "only the removed IPv4 address is clean");
+    check(!filter.is_Malicious_IP("2001:db8::1") && filter.is_Malicious_IP("2001:db8::9"), "only the removed IPv6 address is clean");
+
+    // and adding under two spellings adds once
+    check(filter.apply_delta(parse("# seq 2\n+ 1.2.3.4\n+ 1.2.3.4/32\n")), "the second delta applies");
+    check(filter.prefix_count() == 2 && filter.range_count() == 2, "the prefix is back once");
+    check(filter.is_Malicious_IP("1.2.3.4"), "the re-added address is blocked");
+
+    std::remove(path.c_str());
+}
+
+// a mixed-case host is also matched lowercased, for as long as any listed spelling of it is left
+static void check_host_spellings(std::string const & directory) {
+    std::string path = directory + "/delta_test_hosts.txt";
+    write_list(path, "Evil.com\nEvil.com\nEVIL.com\nOther.example\n");
+    malicious_url_filter filter(path, "", 1);
+    check(filter.is_Malicious_Domain("http://evil.com/") && !filter.is_Malicious_URL("evil.com"), "the lowercased host matches domains only");
+
+    // removing a spelling that is not listed changes nothing, even the lowercased host itself
+    check(filter.apply_delta(parse("# seq 1\n- evil.com\n- other.example\n")), "the first delta applies");
+    check(filter.is_Malicious_Domain("http://evil.com/") && filter.is_Malicious_Domain("http://other.example/"),
+          "removing an unlisted lowercase spelling keeps the host");
+
+    // the host stays while another spelling is listed, however often the first was repeated
+    check(filter.apply_delta(parse("# seq 2\n- Evil.com\n")), "the second delta applies");
+    check(filter.is_Malicious_Domain("http://evil.com/") && !filter.is_Malicious_URL("Evil.com") && filter.is_Malicious_URL("EVIL.com"),
+          "removing one spelling keeps the host for the other");
+    check(filter.apply_delta(parse("# seq 3\n- EVIL.com\n- Other.example\n")), "the third delta applies");
+    check(!filter.is_Malicious_Domain("http://evil.com/") && !filter.is_Malicious_Domain("http://other.example/"),
+          "removing the last spelling removes the host");
+
+    // and adding spellings back counts them again
+    check(filter.apply_delta(parse("# seq 4\n+ Evil.com\n+ EVIL.com\n")), "the fourth delta applies");
+    check(filter.apply_delta(parse("# seq 5\n- EVIL.com\n")), "the fifth delta applies");
+    check(filter.is_Malicious_Domain("http://evil.com/"), "an added spelling keeps the host after another goes");
+
+    std::remove(path.c_str());
+}
+
+// random deltas of IPv4 and IPv6 prefixes, nested and overlapping, and domains in two letter cases
+static std::mt19937_64 rng(7);
+
+static std::string random_ipv4() {
+    int length = rng() % 200 == 0 ? 12 : 18 + static_cast<int>(rng() % 15);
+    uint32_t network = 0x0A000000u | (static_cast<uint32_t>(rng()) & 0x003FFFFFu);
+    if (rng() % 3 == 0) network &= 0xFFFF0000u;
+    network &= ipv4_mask(static_cast<uint8_t>(length));
+    char text[40];
+    std::snprintf(text, sizeof(text), "%u.%u.%u.%u/%d", network >> 24, (network >> 16) & 255, (network >> 8) & 255, network & 255, length);
+    return text;
+}
+
+static std::string random_ipv6() {
+    int length = rng() % 200 == 0 ? 34 : 40 + static_cast<int>(rng() % 25);
+    uint64_t high = UINT64_C(0x20010db800000000) | (rng() & 0x00FFFFFFu);
+    if (rng() % 3 == 0) high &= UINT64_C(0xFFFFFFFFFF000000);
+    ipv6_address network = ipv6_mask(ipv6_address { high, 0 }, static_cast<uint8_t>(length));
+    char text[80];
+    std::snprintf(text, sizeof(text), "%x:%x:%x:%x::/%d", unsigned(network.high >> 48), unsigned((network.high >> 32) & 0xffff),
+                  unsigned((network.high >> 16) & 0xffff), unsigned(network.high & 0xffff), length);
+    return text;
+}
+
+static std::string random_domain() {
+    int n = static_cast<int>(rng() % 2000);
+    return (n % 5 == 0 ? "D" : "d") + std::to_string(n) + (n % 5 == 0 ? ".Example" : ".example");
+}
+
+static std::string random_entry() {
+    switch (rng() % 3) {
+        case 0: return random_ipv4();
+        case 1: return random_ipv6();
+        default: return random_domain();
+    }
+}
+
+static std::string list_text(std::set<std::string> const & entries) {
+    std::string text;
+    for (std::string const & entry : entries) text += entry + "\n";
+    return text;
+}
+
+static void check_against_fresh_loads(std::string const & directory) {
+    std::string path = directory + "/delta_test_random.txt";
+    std::set<std::string> listed, seen;
+    for (int i = 0; i < 3000; ++i) {
+        std::string entry = random_entry();
+        listed.insert(entry);
+        seen.insert(entry);
+    }
+    write_list(path, list_text(listed));
+    malicious_url_filter filter(path, "", 1);
+
+    size_t disagreements = 0;
+    for (uint64_t round = 1; round <= 20; ++round) {
+        filter_delta delta;
+        delta.sequence = round;
+        std::set<std::string> used;
+        for (int k = 0; k < 60; ++k) {
+            std::string entry;
+            if (rng() % 2 && !listed.empty()) entry = *std::next(listed.begin(), static_cast<long>(rng() % listed.size()));
+            else entry = random_entry();
+            if (!used.insert(entry).second) continue;
+            seen.insert(entry);
+            if (rng() % 2) {
+                delta.added.push_back(entry);
+                listed.insert(entry);
+            } else {
+                delta.removed.push_back(entry);
+                listed.erase(entry);
+            }
+        }
+        check(filter.apply_delta(delta), "random delta " + std::to_string(round) + " applies");
+        check(!filter.apply_delta(delta), "random delta " + std::to_string(round) + " does not apply twice");
+        if (round % 5 != 0) continue;
+
+        write_list(path, list_text(listed));
+        malicious_url_filter fresh(path, "", 1);
+        for (int i = 0; i < 100000; ++i) {
+            uint32_t address = i % 10 ? 0x0A000000u | (static_cast<uint32_t>(rng()) & 0x3FFFFFu) : static_cast<uint32_t>(rng());
+            disagreements += filter.is_Malicious_IP(address) != fresh.is_Malicious_IP(address);
+            ipv6_address address6 { UINT64_C(0x20010db800000000) | (rng() & 0xFFFFFFFFu), rng() };
+            disagreements += filter.is_Malicious_IP(address6) != fresh.is_Malicious_IP(address6);
+        }
+        for (std::string const & entry : seen) {
+            disagreements += filter.is_Malicious_URL(entry) != fresh.is_Malicious_URL(entry);
+            disagreements += filter.is_Malicious_Domain("http://a." + entry + "/x") != fresh.is_Malicious_Domain("http://a." + entry + "/x");
+        }
+        check(filter.prefix_count() == fresh.prefix_count() && filter.ipv6_prefix_count() == fresh.ipv6_prefix_count(),
+              "prefix counts match a fresh load after round " + std::to_string(round));
+    }
+    check(disagreements == 0, std::to_string(disagreements) + " lookups disagree with a fresh load");
+
+    std::remove(path.c_str());
+}
+
+// a reloadable_filter applies deltas to the list it loaded, not to whatever the file holds now
+static void check_edited_list(std::string const & directory) {
+    std::string path = directory + "/delta_test_reloadable.txt";
+    write_list(path, "old.example\n198.51.100.0/24\n");
+    reloadable_filter filter(path);
+
+    // edit the file and do not reload
+    write_list(path, "new.example\n203.0.113.0/24\n");
+
+    for (uint64_t sequence = 1; sequence <= 4; ++sequence) {
+        std::string added = "added" + std::to_string(sequence) + ".example";
+        check(filter.apply_delta(parse("# seq " + std::to_string(sequence) + "\n+ " + added + "\n")), "delta applies");
+        std::string after = " after delta " + std::to_string(sequence);
+        check(filter.is_Malicious_URL("old.example") && filter.is_Malicious_IP("198.51.100.7"), "the loaded list is kept" + after);
+        check(!filter.is_Malicious_URL("new.example") && !filter.is_Malicious_IP("203.0.113.7"), "the edited file is not read" + after);
+        for (uint64_t earlier = 1; earlier <= sequence; ++earlier)
+            check(filter.is_Malicious_URL("added" + std::to_string(earlier) + ".example"), "every delta so far is there" + after);
+    }
+
+    // a reload picks up the edit, and deltas then apply to it
+    check(filter.reload_now(), "the edited list reloads");
+    check(filter.is_Malicious_URL("new.example") && !filter.is_Malicious_URL("old.example"), "the reload reads the edit");
+    check(filter.apply_delta(parse("# seq 1\n- new.example\n")), "a delta applies after the reload");
+    check(filter.apply_delta(parse("# seq 2\n+ later.example\n")), "a second delta applies after the reload");
+    check(!filter.is_Malicious_URL("new.example") && filter.is_Malicious_URL("later.example")
+          && filter.is_Malicious_IP("203.0.113.7"), "both copies hold the reloaded list");
+
+    std::remove(path.c_str());
+}
+
+int main(int argc, char ** argv) {
+
+    std::string directory = argc > 1 ? argv[1] : "/tmp";
+
+    check_parser();
+    check_two_spellings(directory);
+    check_host_spellings(directory);
+    check_against_fresh_loads(directory);
+    check_edited_list(directory);
+
+    if (failures != 0) {
+        std::cerr << failures << " check(s) failed\n";
+        return 1;
+    }
+    std::cout << "deltas: ok\n";
+
+}
@@ -0,0 +1,113 @@
+// Round-trips a small block list through a snapshot and checks that mapped_filter
+// answers every lookup the way the filter it was written from does.
+//
+// Build from the repository root:
+//     g++ -O2 -std=c++17 -Isrc tests/snapshot_test.cpp $(ls src/*.cpp | grep -v main.cpp) -pthread -o snapshot_test
+// Run:
+//     ./snapshot_test [scratch directory, default /tmp]
+// Exits nonzero on any disagreement.
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "malicious_url_filter.h"
+#include "snapshot.h"
+
+static const char * const LIST =
+    "evil.example\n"
+    "Mixed.Case.Example\n"
+    "http://phish.example/login\n"
+    "198.51.100.0/24\n"
+    "203.0.113.7\n"
+    "2001:db8::/32\n"
+    "2001:DB8:1::1\n"
+    "fe80::/10\n";
+
+static size_t failures = 0;
+
+static void expect(const char * what, std::string const & input, bool filter, bool mapped) {
+    if (filter == mapped) return;
+    std::cerr << what << "(" << input << "): filter says " << filter << ", snapshot says " << mapped << "\n";
+    ++failures;
+}
+
+int main(int argc, char ** argv) {
+
+    std::string directory = argc > 1 ? argv[1] : "/tmp";
+    std::string list_path = directory + "/snapshot_test_list.txt";
+    std::string snapshot_path = directory + "/snapshot_test.snap";
+
+    {
+        std::ofstream list(list_path, std::ios::binary | std::ios::trunc);
+        list << LIST;
+        if (!list.flush()) {
+            std::cerr << "cannot write " << list_path << "\n";
+            return 2;
+        }
+    }
+
+    malicious_url_filter filter(list_path);
+    if (!filter.write_snapshot(snapshot_path)) {
+        std::cerr << "cannot write " << snapshot_path << "\n";
+        return 2;
+    }
+    mapped_filter mapped(snapshot_path);
+    if (!mapped.is_open()) {
+        std::cerr << snapshot_path << " was written but does not load\n";
+        return 1;
+    }
+
+    if (mapped.ipv6_prefix_count() != filter.ipv6_prefix_count()) {
+        std::cerr << "snapshot holds " << mapped.ipv6_prefix_count() << " IPv6 prefixes, the filter "
+                  << filter.ipv6_prefix_count() << "\n";
+        ++failures;
+    }
+
+    const std::vector<std::string> entries = {
+        "evil.example", "mixed.case.example", "Mixed.Case.Example", "http://phish.example/login",
+        "198.51.100.0/24", "198.51.100.9/24", "198.51.100.0/25", "203.0.113.7", "203.0.113.7/32",
+        "2001:db8::/32", "2001:0db8:0000::/32", "2001:db8::/33", "2001:db8:1::1", "2001:db8:1::1/128",
+        "fe80::/10", "fe80::/11", "example.org", "2001:db9::/32",
+    };
+    for (std::string const & entry : entries) expect("is_Malicious_URL", entry, filter.is_Malicious_URL(entry), mapped.is_Malicious_URL(entry));
+
+    const std::vector<std::string> addresses = {
+        "198.51.100.200", "198.51.101.1", "203.0.113.7", "203.0.113.8", "2001:db8:ffff::1", "2001:db9::1",
+        "2001:db8:1::1", "fe80::1", "febf:ffff::1", "fec0::1", "::1", "not an address",
+    };
+    for (std::string const & address : addresses) expect("is_Malicious_IP", address, filter.is_Malicious_IP(address), mapped.is_Malicious_IP(address));
+
+    const std::vector<std::string> urls = {
+        "http://www.evil.example/path", "https://MIXED.case.example", "http://[2001:db8::5]:8080/x",
+        "http://[2001:db9::5]/", "http://198.51.100.4/", "http://example.org/", "http://[fe80::1]/",
+    };
+    for (std::string const & url : urls) expect("is_Malicious_Domain", url, filter.is_Malicious_Domain(url), mapped.is_Malicious_Domain(url));
+
+    // and the IPv6 entries really are there, not just missing from both
+    if (!mapped.is_Malicious_URL("2001:db8::/32") || !mapped.is_Malicious_IP("2001:db8:1::1")
+        || !mapped.is_Malicious_Domain("http://[fe80::1]/")) {
+        std::cerr << "the snapshot lost its IPv6 entries\n";
+        ++failures;
+    }
+
+    // a host listed in mixed case matches domain lookups in any case, but exact lookups only as written
+    if (filter.is_Malicious_URL("mixed.case.example") || mapped.is_Malicious_URL("mixed.case.example")
+        || !mapped.is_Malicious_URL("Mixed.Case.Example") || !mapped.is_Malicious_Domain("http://a.mixed.case.example/")) {
+        std::cerr << "the lowercased host leaks into exact lookups\n";
+        ++failures;
+    }
+
+    std::remove(list_path.c_str());
+    std::remove(snapshot_path.c_str());
+
+    if (failures != 0) {
+        std::cerr << failures << " disagreement(s)\n";
+        return 1;
+    }
+    std::cout << "snapshot round trip: ok (" << mapped.key_count() << " keys, " << mapped.prefix_count()
+              << " IPv4 and " << mapped.ipv6_prefix_count() << " IPv6 prefixes)\n";
+
+}
@@ -0,0 +1,38 @@
+// Compiles a block list into a binary snapshot for mapped_filter.
+//
+// Build from the repository root:
+//     g++ -O2 -std=c++17 -Isrc tools/compile_snapshot.cpp $(ls src/*.cpp | grep -v main.cpp) -pthread -o compile_snapshot
+// Usage:
+//     ./compile_snapshot src/resources/block.txt block.snap
+
+#include <iostream>
+#include <string>
+
+#include "malicious_url_filter.h"
+#include "snapshot.h"
+
+int main(int argc, char ** argv) {
+
+    if (argc != 3) {
+        std::cerr << "usage: " << argv[0] << " <block list> <snapshot>\n";
+        return 2;
+    }
+
+    malicious_url_filter filter(argv[1]);
+    if (!filter.write_snapshot(argv[2])) {
+        std::cerr << "failed to write " << argv[2] << "\n";
+        return 1;
+    }
+
+    // map the result back to check it loads
+    mapped_filter mapped(argv[2]);
+    if (!mapped.is_open()) {
+        std::cerr << argv[2] << " was written but does not load\n";
+        return 1;
+    }
+
+    std::cout << argv[2] << ": " << mapped.key_count() << " keys, " << mapped.prefix_count()
+              << " prefixes, " << mapped.ipv6_prefix_count()
+              << " IPv6 prefixes, " << mapped.mapped_size() << " bytes\n";
+
+}
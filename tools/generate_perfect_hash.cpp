@@ -0,0 +1,243 @@
+// Compiles a block list into a header of minimal perfect hash tables for embedded_filter.
+//
+// Build from the repository root:
+//     g++ -O2 -std=c++17 -Isrc tools/generate_perfect_hash.cpp $(ls src/*.cpp | grep -v main.cpp) -pthread -o generate_perfect_hash
+// Usage (the output is generated, not checked in):
+//     ./generate_perfect_hash src/resources/block.txt src/embedded_block_list.h
+// then build with -DMALICIOUS_FILTER_EMBEDDED to serve that list with no file at run time.
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ipv4.h"
+#include "ipv6.h"
+#include "perfect_hash.h"
+#include "url.h"
+
+// how many displacements a bucket may try before the whole build is reseeded
+static const uint32_t MAX_DISPLACEMENT = 1u << 20;
+
+// average keys per bucket; fewer buckets means a smaller header but a slower build
+static const size_t BUCKET_SIZE = 4;
+
+struct perfect_hash_table {
+    uint64_t seed = 0;
+    std::vector<uint32_t> displacements {};
+    std::vector<uint32_t> slots {};   // slots[i] is the slot of keys[i]
+};
+
+/*
+    Hash and displace: place the biggest buckets first, and give each the first
+    displacement that sends all of its keys to distinct free slots. Keys must
+    be distinct.
+*/
+template <typename Key>
+static bool build_table(const std::vector<Key> & keys, uint64_t seed, perfect_hash_table & table) {
+
+    uint32_t n = static_cast<uint32_t>(keys.size());
+    uint32_t bucket_count = static_cast<uint32_t>(keys.size() / BUCKET_SIZE + 1);
+
+    std::vector<uint64_t> hashes(n);
+    std::vector<std::vector<uint32_t>> buckets(bucket_count);
+    for (uint32_t i = 0; i < n; ++i) {
+        hashes[i] = perfect_hash_key(keys[i], seed);
+        buckets[perfect_hash_index::bucket(hashes[i], bucket_count)].push_back(i);
+    }
+
+    std::vector<uint32_t> order(bucket_count);
+    for (uint32_t b = 0; b < bucket_count; ++b) order[b] = b;
+    std::stable_sort(order.begin(), order.end(), [&buckets](uint32_t a, uint32_t b) {
+        return buckets[a].size() > buckets[b].size();
+    });
+
+    table.seed = seed;
+    table.displacements.assign(bucket_count, 0);
+    table.slots.assign(n, 0);
+    std::vector<bool> taken(n, false);
+    std::vector<uint32_t> trial;
+
+    for (uint32_t b : order) {
+        const std::vector<uint32_t> & members = buckets[b];
+        if (members.empty()) break;
+
+        uint32_t d = 0;
+        for (; d < MAX_DISPLACEMENT; ++d) {
+            trial.clear();
+            bool fits = true;
+            for (uint32_t i : members) {
+                uint32_t slot = perfect_hash_index::slot(hashes[i], d, n);
+                if (taken[slot] || std::find(trial.begin(), trial.end(), slot) != trial.end()) {
+                    fits = false;
+                    break;
+                }
+                trial.push_back(slot);
+            }
+            if (fits) break;
+        }
+        if (d == MAX_DISPLACEMENT) return false;
+
+        table.displacements[b] = d;
+        for (size_t k = 0; k < members.size(); ++k) {
+            taken[trial[k]] = true;
+            table.slots[members[k]] = trial[k];
+        }
+    }
+
+    return true;
+
+}
+
+template <typename Key>
+static perfect_hash_table build_with_retries(const std::vector<Key> & keys) {
+    perfect_hash_table table;
+    uint64_t seed = UINT64_C(0x5851F42D4C957F2D);
+    while (!build_table(keys, seed, table)) seed = perfect_hash_mix(seed + 1);
+    return table;
+}
+
+template <typename T>
+static void write_array(std::ostream & out, const char * type, const char * name, const std::vector<T> & values) {
+    out << "static constexpr " << type << " " << name << "[] = {";
+    for (size_t i = 0; i < values.size(); ++i) out << (i % 8 == 0 ? "\n    " : " ") << values[i] << "u,";
+    if (values.empty()) out << " 0";
+    out << "\n};\n\n";
+}
+
+// a C++ string literal for bytes, split across lines; octal escapes never swallow the next character
+static void write_bytes(std::ostream & out, const char * name, const std::string & bytes) {
+    out << "static constexpr char " << name << "[] =\n    \"";
+    for (size_t i = 0; i < bytes.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(bytes[i]);
+        if (c >= 0x20 && c < 0x7f && c != '"' && c != '\\' && c != '?') out << static_cast<char>(c);
+        else out << '\\' << static_cast<char>('0' + (c >> 6)) << static_cast<char>('0' + ((c >> 3) & 7)) << static_cast<char>('0' + (c & 7));
+        if (i % 96 == 95) out << "\"\n    \"";
+    }
+    out << "\";\n\n";
+}
+
+int main(int argc, char ** argv) {
+
+    if (argc != 3) {
+        std::cerr << "usage: " << argv[0] << " <block list> <header>\n";
+        return 2;
+    }
+
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in) {
+        std::cerr << "cannot read " << argv[1] << "\n";
+        return 1;
+    }
+    std::stringstream contents;
+    contents << in.rdbuf();
+    std::string text = contents.str();
+
+    // split the list the same way the filter does, and drop duplicates
+    std::vector<ipv4_prefix> parsed;
+    std::vector<std::string_view> others;
+    parse_ipv4_cidr_lines(text, parsed, others);
+
+    std::vector<uint64_t> prefixes;
+    uint64_t lengths = 0;
+    for (const ipv4_prefix & prefix : parsed) {
+        prefixes.push_back(perfect_hash_prefix(prefix.network, prefix.length));
+        lengths |= uint64_t(1) << prefix.length;
+    }
+    std::sort(prefixes.begin(), prefixes.end());
+    prefixes.erase(std::unique(prefixes.begin(), prefixes.end()), prefixes.end());
+
+    // IPv6 CIDR entries leave the others too, for a sorted table grouped by length
+    std::vector<ipv6_prefix> parsed6;
+    size_t kept = 0;
+    for (std::string_view line : others) {
+        ipv6_prefix prefix;
+        if (parse_ipv6_cidr(line, prefix)) parsed6.push_back(prefix);
+        else others[kept++] = line;
+    }
+    others.resize(kept);
+    std::sort(parsed6.begin(), parsed6.end(), [](const ipv6_prefix & a, const ipv6_prefix & b) {
+        return a.length != b.length ? a.length < b.length : a.network < b.network;
+    });
+    parsed6.erase(std::unique(parsed6.begin(), parsed6.end()), parsed6.end());
+
+    std::vector<uint64_t> prefix6_words;
+    std::vector<uint32_t> prefix6_starts;
+    std::vector<uint64_t> lengths6(3, 0);
+    for (const ipv6_prefix & prefix : parsed6) {
+        prefix6_words.push_back(prefix.network.high);
+        prefix6_words.push_back(prefix.network.low);
+        lengths6[prefix.length / 64] |= uint64_t(1) << (prefix.length % 64);
+    }
+    for (size_t length = 0, i = 0; length <= 129; ++length) {
+        prefix6_starts.push_back(static_cast<uint32_t>(i));
+        while (i < parsed6.size() && parsed6[i].length == length) ++i;
+    }
+
+    // bare host names also go in normalized, as malicious_url_filter stores them
+    std::vector<std::string> hosts;
+    char buffer[URL_HOST_MAX];
+    for (std::string_view line : others) {
+        std::string_view host;
+        if (extract_url_host(line, buffer, host) && host.size() == line.size() - (line.back() == '.')
+                && host.front() != '[' && host != line) hosts.emplace_back(host);
+    }
+    for (const std::string & host : hosts) others.push_back(host);
+
+    std::sort(others.begin(), others.end());
+    others.erase(std::unique(others.begin(), others.end()), others.end());
+
+    perfect_hash_table prefix_table = build_with_retries(prefixes);
+    perfect_hash_table key_table = build_with_retries(others);
+
+    // lay the keys out in slot order
+    std::vector<uint64_t> prefix_slots(prefixes.size());
+    for (size_t i = 0; i < prefixes.size(); ++i) prefix_slots[prefix_table.slots[i]] = prefixes[i];
+
+    std::vector<std::string_view> key_slots(others.size());
+    for (size_t i = 0; i < others.size(); ++i) key_slots[key_table.slots[i]] = others[i];
+    std::string key_bytes;
+    std::vector<uint32_t> key_offsets;
+    for (std::string_view key : key_slots) {
+        key_offsets.push_back(static_cast<uint32_t>(key_bytes.size()));
+        key_bytes.append(key.data(), key.size());
+    }
+    key_offsets.push_back(static_cast<uint32_t>(key_bytes.size()));
+
+    std::ofstream out(argv[2], std::ios::trunc);
+    out << "// Generated by tools/generate_perfect_hash.cpp from " << argv[1] << ". Do not edit.\n"
+        << "#pragma once\n\n#include <cstdint>\n\n#include \"perfect_hash.h\"\n\n";
+
+    out << "// " << prefixes.size() << " CIDR entries, keyed by perfect_hash_prefix\n";
+    write_array(out, "uint32_t", "EMBEDDED_PREFIX_DISPLACEMENTS", prefix_table.displacements);
+    write_array(out, "uint64_t", "EMBEDDED_PREFIX_SLOTS", prefix_slots);
+    out << "static constexpr perfect_hash_index EMBEDDED_PREFIXES = { " << prefix_table.seed << "u, "
+        << prefix_table.displacements.size() << "u, " << prefixes.size() << "u, EMBEDDED_PREFIX_DISPLACEMENTS };\n"
+        << "static constexpr uint64_t EMBEDDED_PREFIX_LENGTHS = " << lengths << "u;\n\n";
+
+    out << "// " << parsed6.size() << " IPv6 CIDR entries as (high, low) word pairs, grouped by length and sorted within it;\n"
+        << "// length L is pairs [starts[L], starts[L + 1]), and bit L % 64 of LENGTHS[L / 64] is set when it has any\n";
+    write_array(out, "uint64_t", "EMBEDDED_PREFIX6_WORDS", prefix6_words);
+    write_array(out, "uint32_t", "EMBEDDED_PREFIX6_STARTS", prefix6_starts);
+    write_array(out, "uint64_t", "EMBEDDED_PREFIX6_LENGTHS", lengths6);
+
+    out << "// " << others.size() << " other entries; slot i holds bytes [offsets[i], offsets[i + 1])\n";
+    write_array(out, "uint32_t", "EMBEDDED_KEY_DISPLACEMENTS", key_table.displacements);
+    write_array(out, "uint32_t", "EMBEDDED_KEY_OFFSETS", key_offsets);
+    write_bytes(out, "EMBEDDED_KEY_BYTES", key_bytes);
+    out << "static constexpr perfect_hash_index EMBEDDED_KEYS = { " << key_table.seed << "u, "
+        << key_table.displacements.size() << "u, " << others.size() << "u, EMBEDDED_KEY_DISPLACEMENTS };\n";
+
+    if (!out.flush()) {
+        std::cerr << "failed to write " << argv[2] << "\n";
+        return 1;
+    }
+
+    std::cout << argv[2] << ": " << prefixes.size() << " prefixes, " << parsed6.size() << " IPv6 prefixes, "
+              << others.size() << " other entries\n";
+
+}